@@ -6,13 +6,22 @@
  * CcTrx                  *
  **************************/
 
-CcTrx::CcTrx(): id(ID_INVALID), active(true) {}
+/* Compile-time checks that CcTrx's bitfields are wide enough.
+ * (C++03 doesn't have static_assert.) */
+typedef char stable_replies_must_fit_in_2_bits[ADAPTIVE_POLL_STABLE_REPLIES <= 3 ? 1 : -1];
+typedef char demote_after_misses_must_fit_in_2_bits[TRX_DEMOTE_AFTER_MISSES <= 3 ? 1 : -1];
+typedef char max_probe_interval_must_fit_in_7_bits[TRX_MAX_PROBE_INTERVAL <= 128 ? 1 : -1];
 
+CcTrx::CcTrx()
+: Sensor(), srtt_x8(0), rttvar_x4(0), last_watts(WATTS_INVALID),
+  poll_interval_log2(0), stable_replies(0), consecutive_misses(0),
+  unreported(false), roll_calls_to_skip(0) {}
 
-CcTrx::CcTrx(const id_t& _id): id(_id), active(true) {}
 
-
-CcTrx::~CcTrx() {}
+CcTrx::CcTrx(const id_t& _id)
+: Sensor(_id), srtt_x8(0), rttvar_x4(0), last_watts(WATTS_INVALID),
+  poll_interval_log2(0), stable_replies(0), consecutive_misses(0),
+  unreported(false), roll_calls_to_skip(0) {}
 
 
 void CcTrx::print() const
@@ -21,22 +30,145 @@ void CcTrx::print() const
     Serial.print(id);
     Serial.print(F(", \"active\": "));
     Serial.print(active);
+    Serial.print(F(", \"rtt\": "));
+    Serial.print(get_rtt());
+    Serial.print(F(", \"timeout\": "));
+    Serial.print(get_timeout());
+    Serial.print(F(", \"poll_interval\": "));
+    Serial.print(get_poll_interval());
+    Serial.print(F(", \"misses\": "));
+    Serial.print(get_consecutive_misses());
+    Serial.print(F(", \"demoted\": "));
+    Serial.print(is_demoted());
     Serial.print(F("}"));
 }
 
-bool CcTrx::is_active() const
+void CcTrx::add_rtt_sample(const millis_t& rtt)
+{
+    if (rtt > CC_TRX_TIMEOUT) {
+        return; // can't have been a reply to our poll
+    }
+    const int16_t sample = rtt ? rtt : 1; // srtt_x8 == 0 means no samples
+
+    if (srtt_x8 == 0) {
+        srtt_x8 = sample << 3;
+        rttvar_x4 = sample << 1; // deviation = rtt / 2
+    } else {
+        /* srtt = 7/8 srtt + 1/8 rtt;  rttvar = 3/4 rttvar + 1/4 |error| */
+        int16_t error = sample - (srtt_x8 >> 3);
+        srtt_x8 += error;
+        if (error < 0) error = -error;
+        const int16_t new_rttvar_x4 = rttvar_x4 + error - (rttvar_x4 >> 2);
+        rttvar_x4 = new_rttvar_x4 > 0xFF ? 0xFF : new_rttvar_x4;
+    }
+}
+
+
+uint8_t CcTrx::get_rtt() const
+{
+    return srtt_x8 >> 3;
+}
+
+
+uint8_t CcTrx::get_timeout() const
+{
+    if (srtt_x8 == 0) {
+        return CC_TRX_TIMEOUT;
+    }
+
+    const uint16_t timeout = (srtt_x8 >> 3) + rttvar_x4;
+    if (timeout < CC_TRX_TIMEOUT_MIN) {
+        return CC_TRX_TIMEOUT_MIN;
+    } else if (timeout > CC_TRX_TIMEOUT) {
+        return CC_TRX_TIMEOUT;
+    } else {
+        return timeout;
+    }
+}
+
+
+void CcTrx::update_poll_interval(const watts_t& watts, const uint8_t& max_interval)
+{
+    const watts_t change = watts > last_watts ? watts - last_watts : last_watts - watts;
+
+    if (last_watts == WATTS_INVALID || change > ADAPTIVE_POLL_DEADBAND) {
+        poll_interval_log2 = 0;
+        stable_replies = 0;
+    } else {
+        if (stable_replies < ADAPTIVE_POLL_STABLE_REPLIES) {
+            stable_replies++; // a single small change could be a coincidence
+        }
+        if (stable_replies == ADAPTIVE_POLL_STABLE_REPLIES && get_poll_interval() <= max_interval >> 1) {
+            poll_interval_log2++;
+        }
+    }
+
+    while (poll_interval_log2 > 0 && get_poll_interval() > max_interval) {
+        poll_interval_log2--;
+    }
+    roll_calls_to_skip = get_poll_interval() - 1;
+    last_watts = watts;
+}
+
+
+bool CcTrx::due_for_poll() const
+{
+    // Always poll TRXs which didn't answer last time, unless demoted
+    return (!active && !is_demoted()) || roll_calls_to_skip == 0;
+}
+
+
+void CcTrx::missed_poll()
+{
+    if (consecutive_misses < TRX_DEMOTE_AFTER_MISSES) {
+        consecutive_misses++; // no need to count any further
+    }
+
+    if (is_demoted()) {
+        if (get_poll_interval() <= TRX_MAX_PROBE_INTERVAL >> 1) {
+            poll_interval_log2++;
+        }
+        while (get_poll_interval() > TRX_MAX_PROBE_INTERVAL) {
+            poll_interval_log2--;
+        }
+        roll_calls_to_skip = get_poll_interval() - 1;
+        last_watts = WATTS_INVALID;
+    }
+}
+
+
+void CcTrx::heard()
+{
+    if (is_demoted()) {
+        // Poll every roll call again until we know its reading is stable
+        poll_interval_log2 = 0;
+        roll_calls_to_skip = 0;
+    }
+    consecutive_misses = 0;
+}
+
+
+void CcTrx::sit_out_roll_call()
 {
-    return active;
+    if (roll_calls_to_skip > 0) {
+        roll_calls_to_skip--;
+    }
 }
 
+
 /*************************
  * CcTx                  *
  *************************/
 
-CcTx::CcTx():CcTrx() { init(); }
+/* Error which would make the window CC_TX_WINDOW long, squared */
+const uint16_t INITIAL_SQ_ETA_ERROR =
+        ((CC_TX_WINDOW_OPEN - CC_TX_WINDOW_MARGIN) / CC_TX_WINDOW_SIGMAS) *
+        ((CC_TX_WINDOW_OPEN - CC_TX_WINDOW_MARGIN) / CC_TX_WINDOW_SIGMAS);
 
+CcTx::CcTx():Sensor(), sq_eta_error(INITIAL_SQ_ETA_ERROR) { init(); }
 
-CcTx::CcTx(const id_t& _id): CcTrx(_id) { init(); }
+
+CcTx::CcTx(const id_t& _id): Sensor(_id), sq_eta_error(INITIAL_SQ_ETA_ERROR) { init(); }
 
 
 void CcTx::init()
@@ -46,7 +178,12 @@ void CcTx::init()
      * force the Arduino IDE to use C++11.
      * http://stackoverflow.com/questions/308276/c-call-constructor-from-constructor */
     eta = 0xFFFFFFFF - CC_TX_WINDOW_OPEN - SAMPLE_PERIOD;
+    phase = eta;
+    period_x256 = SAMPLE_PERIOD << 8;
+    eta_error = 0;
+    num_samples = 0;
     num_periods_missed = 0;
+    period_restored = false;
     last_seen = 0;
 }
 
@@ -65,7 +202,13 @@ void CcTx::print()
     Serial.print(F(", \"eta\": "));
     Serial.print(eta);
     Serial.print(F(", \"sample_period\": "));
-    Serial.print(sample_period.get_av());
+    Serial.print(get_period());
+    Serial.print(F(", \"eta_error\": "));
+    Serial.print(eta_error);
+    Serial.print(F(", \"eta_error_sd\": "));
+    Serial.print(get_eta_error_sd());
+    Serial.print(F(", \"window\": "));
+    Serial.print(get_window_open() * 2);
     Serial.print(F(", \"active\": "));
     Serial.print(active);
     Serial.print(F("}"));
@@ -74,50 +217,142 @@ void CcTx::print()
 
 void CcTx::update(const RxPacketFromSensor& packet)
 {
-    if (last_seen != 0) {
-        uint16_t new_sample_period;
+    const millis_t timecode = packet.get_timecode();
+    update(timecode);
+}
 
-        // update sample period for this Sensor
-        // (seems to vary a little between sensors)
-        new_sample_period = (packet.get_timecode() - last_seen) / num_periods_missed;
 
-        // Check the new sample_period is sane
-        if (new_sample_period > 5500 && new_sample_period < 6500) {
-            sample_period.add_sample(new_sample_period);
-            log(DEBUG, PSTR("TX %lu. Adding new_sample_period %u, average now=%u"),
-                    id, new_sample_period, sample_period.get_av()); /* Adding new sample period */
+void CcTx::update(const millis_t& timecode)
+{
+    /* Alpha-beta filter over arrival times: predict this arrival from
+     * the filtered phase and period, then correct both by a fraction
+     * of the prediction error.  The number of periods since phase is
+     * worked out from the timecode itself so that arrivals we didn't
+     * expect (e.g. after a window we gave up on) are still counted
+     * correctly. */
+    const millis_t elapsed = timecode - phase;
+    const millis_t period = get_period();
+    const millis_t n = (elapsed + period/2) / period;
+
+    if (num_samples > 0 && n == 0) {
+        // Another packet from a period we've already heard
+        last_seen = timecode;
+        active = true;
+        return;
+    }
+
+    if (num_samples == 0 || n > 0xFF) {
+        // First packet, or we haven't heard this TX for ages
+        phase = timecode;
+    } else {
+        const int32_t error = timecode - predict(n);
+        eta_error = error;
+        const uint32_t sq_error = error * error;
+        sq_eta_error.add_sample(sq_error > 0xFFFF ? 0xFFFF : sq_error);
+
+        const bool outside_window = eta_error > (int16_t)CC_TX_WINDOW_OPEN ||
+                                    eta_error < -(int16_t)CC_TX_WINDOW_OPEN;
+        if (num_samples == 1 && (!period_restored || outside_window)) {
+            // Second packet: measure the period directly, unless the
+            // period we restored predicted it
+            period_x256 = (elapsed << 8) / n;
+            phase = timecode;
+        } else if (outside_window) {
+            // Way outside the window.  Don't let it skew the period.
+            log(INFO, PSTR("TX %lu. ETA error %d. Re-syncing"), id, eta_error);
+            phase = timecode;
+        } else {
+            phase = predict(n) + error / (1 << CC_TX_PHASE_GAIN_SHIFT);
+            period_x256 += error * (256 >> CC_TX_PERIOD_GAIN_SHIFT) / (int32_t)n;
         }
+        log(DEBUG, PSTR("TX %lu. ETA error %d, period now %u"),
+                id, eta_error, get_period());
+    }
+
+    if (num_samples < 0xFF) {
+        num_samples++;
     }
-	eta = packet.get_timecode() + sample_period.get_av();
-	num_periods_missed = 1;
-	last_seen = packet.get_timecode();
-	active = true;
+    num_periods_missed = 1;
+    eta = predict(1);
+    last_seen = timecode;
+    active = true;
 }
 
 
-const id_t& CcTx::get_eta()
+void CcTx::restore_timing(const uint32_t& _period_x256, const uint8_t& eta_error_sd)
 {
-    // Sanity-check ETA to make sure it's in the future.
-    if (eta+CC_TX_WINDOW_OPEN < millis() &&
-            eta+CC_TX_WINDOW_OPEN+SAMPLE_PERIOD < millis()+SAMPLE_PERIOD)
-        /* one possible reason
-            for eta < millis() is that millis() has rolled over.
-            If millis() has rolled over
-            then eta+SAMPLE_PERIOD > millis()+SAMPLE_PERIOD.  In other words, only
-            called missing() if the fact that eta < millis cannot be explained
-            by roll-over.  We want to let roll-over do its thing.  */
-    {
-        log(DEBUG, PSTR("eta %lu < millis() %lu. id=%lu. num_periods=%d, active=%d"), eta, millis(), id, num_periods_missed, active);
-        missing();
+    period_x256 = _period_x256;
+    period_restored = true;
+    sq_eta_error = RollingAverage<8, uint16_t, uint32_t>((uint16_t)eta_error_sd * eta_error_sd);
+}
+
+
+uint16_t CcTx::get_period() const
+{
+    return (period_x256 + 0x80) >> 8;
+}
+
+
+uint8_t CcTx::get_eta_error_sd() const
+{
+    /* Integer square root, one bit at a time */
+    const uint16_t sq = sq_eta_error.get_av();
+    uint8_t root = 0;
+    for (uint8_t bit = 0x80; bit; bit >>= 1) {
+        const uint16_t trial = root | bit;
+        if (trial * trial <= sq) {
+            root = trial;
+        }
+    }
+    return root;
+}
+
+
+uint16_t CcTx::get_window_open() const
+{
+    uint16_t open = (uint16_t)get_eta_error_sd() * CC_TX_WINDOW_SIGMAS + CC_TX_WINDOW_MARGIN;
+    if (open < CC_TX_WINDOW_OPEN_MIN) {
+        open = CC_TX_WINDOW_OPEN_MIN;
     }
-	return eta;
+
+    // We may have missed because our window was too narrow.  Widen it.
+    for (uint8_t j=1; j<num_periods_missed && open < CC_TX_WINDOW_OPEN; j++) {
+        open <<= 1;
+    }
+
+    return open > CC_TX_WINDOW_OPEN ? CC_TX_WINDOW_OPEN : open;
+}
+
+
+millis_t CcTx::predict(const millis_t& num_periods) const
+{
+    return phase + ((num_periods * period_x256 + 0x80) >> 8);
+}
+
+
+bool CcTx::is_overdue() const
+{
+    /* One possible reason for eta < millis() is that millis() has
+     * rolled over.  If millis() has rolled over then
+     * eta+SAMPLE_PERIOD > millis()+SAMPLE_PERIOD.  In other words,
+     * we're only overdue if the fact that eta < millis() cannot be
+     * explained by roll-over.  We want to let roll-over do its thing. */
+    const millis_t now = millis();
+    const millis_t window_end = eta + get_window_open();
+    return window_end < now &&
+           window_end+SAMPLE_PERIOD < now+SAMPLE_PERIOD;
 }
 
 
 void CcTx::missing()
 {
-	eta += sample_period.get_av();
+	if (num_periods_missed == 0xFF) {
+	    // Count periods from here on so that the ETA keeps moving
+	    phase = eta;
+	    num_periods_missed = 0;
+	}
 	num_periods_missed++;
+	eta = predict(num_periods_missed);
 
 	if (num_periods_missed > 5) {
 	    active = false;
@@ -133,16 +368,132 @@ void CcTx::missing()
 
 void CcTxArray::next()
 {
-    for (index_t j=0; j<n; j++) {
-        if (data[j].active && data[j].get_eta() < current().get_eta()) {
-            i = j;
+    if (n == 0) return;
+
+    if (use_heap()) {
+        while (data[heap[0]].is_overdue()) {
+            log(DEBUG, PSTR("eta %lu < millis() %lu. id=%lu"),
+                    data[heap[0]].get_eta(), millis(), data[heap[0]].id);
+            data[heap[0]].missing();
+            sift_down(0);
+        }
+        i = heap[0];
+    } else {
+        for (index_t j=0; j<n; j++) {
+            while (data[j].is_overdue()) {
+                data[j].missing();
+            }
+            if (earlier(j, i)) {
+                i = j;
+            }
         }
     }
+
     log(DEBUG, PSTR("Next TX ID=%lu, ETA=%lu"),
             current().id, current().get_eta());
 }
 
 
+void CcTxArray::update(const index_t& index, const RxPacketFromSensor& packet)
+{
+    data[index].update(packet);
+    reschedule(index);
+    next();
+}
+
+
+void CcTxArray::current_missing()
+{
+    current().missing();
+    reschedule(i);
+    next();
+}
+
+
+void CcTxArray::items_changed()
+{
+    if (n == 0 || !use_heap()) {
+        i = 0;
+        return;
+    }
+
+    for (index_t j=0; j<n; j++) {
+        heap[j] = j;
+        heap_pos[j] = j;
+    }
+    for (index_t pos=n/2; pos>0; pos--) {
+        sift_down(pos-1);
+    }
+    i = heap[0];
+}
+
+
+bool CcTxArray::earlier(const index_t& a, const index_t& b) const
+{
+    if (data[a].active != data[b].active) {
+        return data[a].active;
+    }
+    // Windows differ in width so compare when they open.  Compare the
+    // difference, not the times, so that ETAs either side of millis()
+    // rolling over are still in order.
+    const millis_t open_a = data[a].get_eta() - data[a].get_window_open();
+    const millis_t open_b = data[b].get_eta() - data[b].get_window_open();
+    return (int32_t)(open_a - open_b) < 0;
+}
+
+
+void CcTxArray::reschedule(const index_t& index)
+{
+    if (use_heap()) {
+        // ETA usually moves later but update() can make a TX active again
+        sift_up(heap_pos[index]);
+        sift_down(heap_pos[index]);
+    }
+}
+
+
+void CcTxArray::sift_up(index_t pos)
+{
+    while (pos > 0) {
+        const index_t parent = (pos-1) / 2;
+        if (!earlier(heap[pos], heap[parent])) {
+            break;
+        }
+        swap(pos, parent);
+        pos = parent;
+    }
+}
+
+
+void CcTxArray::sift_down(index_t pos)
+{
+    for (;;) {
+        const index_t left = 2*pos + 1;
+        if (left >= n) {
+            break;
+        }
+        const index_t right = left + 1;
+        const index_t child =
+                (right < n && earlier(heap[right], heap[left])) ? right : left;
+        if (!earlier(heap[child], heap[pos])) {
+            break;
+        }
+        swap(pos, child);
+        pos = child;
+    }
+}
+
+
+void CcTxArray::swap(const index_t& pos_a, const index_t& pos_b)
+{
+    const index_t tmp = heap[pos_a];
+    heap[pos_a] = heap[pos_b];
+    heap[pos_b] = tmp;
+    heap_pos[heap[pos_a]] = pos_a;
+    heap_pos[heap[pos_b]] = pos_b;
+}
+
+
 void CcTxArray::print_name() const
 {
     Serial.print(F("CC_TX"));
@@ -153,6 +504,10 @@ void CcTxArray::print_name() const
  * CcTrxArray                 *
  ******************************/
 
+CcTrxArray::CcTrxArray()
+: retry_head(0), retry_n(0), retry_overflow(false), retry_scan(0) {}
+
+
 void CcTrxArray::next()
 {
     i++;
@@ -160,6 +515,68 @@ void CcTrxArray::next()
 }
 
 
+void CcTrxArray::add_retry(const index_t& index)
+{
+    if (retry_n == CC_TRX_RETRY_QUEUE_LENGTH) {
+        if (!retry_overflow) {
+            retry_overflow = true;
+            retry_scan = 0;
+        }
+        return;
+    }
+
+    uint8_t tail = retry_head + retry_n;
+    if (tail >= CC_TRX_RETRY_QUEUE_LENGTH) {
+        tail -= CC_TRX_RETRY_QUEUE_LENGTH;
+    }
+    retry_queue[tail] = index;
+    retry_n++;
+}
+
+
+bool CcTrxArray::peek_retry(index_t& index)
+{
+    if (retry_n) {
+        index = retry_queue[retry_head];
+        return true;
+    }
+
+    if (retry_overflow) {
+        for (; retry_scan < n; retry_scan++) {
+            if (!data[retry_scan].active && !data[retry_scan].is_demoted()) {
+                index = retry_scan;
+                return true;
+            }
+        }
+        retry_overflow = false;
+    }
+
+    return false;
+}
+
+
+void CcTrxArray::pop_retry()
+{
+    if (retry_n) {
+        retry_head++;
+        if (retry_head == CC_TRX_RETRY_QUEUE_LENGTH) {
+            retry_head = 0;
+        }
+        retry_n--;
+    } else if (retry_overflow) {
+        retry_scan++;
+    }
+}
+
+
+void CcTrxArray::clear_retries()
+{
+    retry_head = 0;
+    retry_n = 0;
+    retry_overflow = false;
+}
+
+
 void CcTrxArray::print_name() const
 {
     Serial.print(F("CC_TRX"));
@@ -19,55 +19,280 @@
 
 #include "RxPacketFromSensor.h"
 #include "DynamicArray.h"
+#include "StaticArray.h"
 #include "RollingAv.h"
 
 /**
- * Class for Current Cost / EDF Transceiver (TRX) units
+ * What every Current Cost sensor has.  CcTx and CcTrx are siblings so
+ * that neither carries the other's state.  No virtual methods, so no
+ * vtable pointer either.  5 bytes on AVR.
  */
-class CcTrx {
+class Sensor {
+public:
+    Sensor(): id(ID_INVALID), active(true) {}
+    Sensor(const id_t& _id): id(_id), active(true) {}
+
+    bool is_active() const { return active; }
+
+    id_t id; /* Deliberately public */
+    bool active : 1;
+};
+
+/**
+ * Class for Current Cost / EDF Transceiver (TRX) units.  There can be
+ * hundreds of these so the small counters are packed into bitfields.
+ * 12 bytes on AVR.
+ */
+class CcTrx : public Sensor {
 public:
     CcTrx();
     CcTrx(const id_t& _id);
-    virtual ~CcTrx();
-    virtual void print() const;
-    bool is_active() const;
+    void print() const;
 
-    id_t id; /* Deliberately public */
-    bool active;
+    /**
+     * Learn from the time between sending a poll and receiving the reply.
+     */
+    void add_rtt_sample(const millis_t& rtt);
+
+    /**
+     * @return smoothed round-trip time in ms, or 0 if we have no samples
+     */
+    uint8_t get_rtt() const;
+
+    /**
+     * @return how long to wait for a reply to a poll: the smoothed RTT
+     * plus four deviations, clamped to [CC_TRX_TIMEOUT_MIN, CC_TRX_TIMEOUT].
+     * CC_TRX_TIMEOUT until we have an RTT sample.
+     */
+    uint8_t get_timeout() const;
+
+    /**
+     * Adaptive polling: call with each reading received in reply to a
+     * poll.  Poll every roll call while the reading is changing;
+     * otherwise double the poll interval, up to max_interval roll calls
+     * (a power of two, at most 128).
+     */
+    void update_poll_interval(const watts_t& watts, const uint8_t& max_interval);
+
+    /* @return false if this TRX can sit out this roll call */
+    bool due_for_poll() const;
+
+    /* Call when this TRX isn't polled in a roll call */
+    void sit_out_roll_call();
+
+    /* @return number of roll calls between polls */
+    uint8_t get_poll_interval() const { return 1 << poll_interval_log2; }
+
+    /**
+     * A poll of this TRX went unanswered.  After TRX_DEMOTE_AFTER_MISSES
+     * in a row the TRX is demoted: it's probed once every poll_interval
+     * roll calls, without retries, and poll_interval doubles with each
+     * further miss up to TRX_MAX_PROBE_INTERVAL.
+     */
+    void missed_poll();
+
+    /* We've heard from this TRX.  Promote it if it was demoted. */
+    void heard();
+
+    bool is_demoted() const { return consecutive_misses >= TRX_DEMOTE_AFTER_MISSES; }
+
+    uint8_t get_consecutive_misses() const { return consecutive_misses; }
+
+    /* @return the reading from the last reply to a poll */
+    const watts_t& get_last_watts() const { return last_watts; }
+
+private:
+    /* Round-trip time estimate, in the style of TCP's retransmission timer
+     * (RFC 6298).  Stored in fixed point to avoid floats:
+     * srtt_x8 = smoothed RTT * 8 (0 means no samples yet),
+     * rttvar_x4 = mean deviation * 4. */
+    uint16_t srtt_x8;
+    uint8_t  rttvar_x4;
+
+    watts_t  last_watts;
+
+    uint8_t  poll_interval_log2 : 3;  /* poll every 1 << this roll calls */
+    uint8_t  stable_replies : 2;      /* in a row, up to ADAPTIVE_POLL_STABLE_REPLIES */
+    uint8_t  consecutive_misses : 2;  /* saturates at TRX_DEMOTE_AFTER_MISSES */
+
+public:
+    bool     unreported : 1;  /* last_watts is waiting for Manager::print_trx_batch() */
+
+private:
+    uint8_t  roll_calls_to_skip : 7;  /* before the next poll */
 };
 
 /**
  * Class for Current Cost Transmit-Only units
  */
-class CcTx : public CcTrx {
+class CcTx : public Sensor {
 public:
 	CcTx();
 	CcTx(const id_t& _id);
 	~CcTx();
 	void update(const RxPacketFromSensor& packet);
+
+	/* We heard this TX at timecode */
+	void update(const millis_t& timecode);
+
 	void missing();
-	const millis_t& get_eta();
+	const millis_t& get_eta() const { return eta; }
+
+	/* @return learned sample period in ms */
+	uint16_t get_period() const;
+
+	/* @return learned sample period in 1/256 ms (see WarmStart) */
+	const uint32_t& get_period_x256() const { return period_x256; }
+
+	/* Start from the period and ETA error SD learned before a restart
+	 * (see WarmStart).  The phase is learned from the next packet. */
+	void restore_timing(const uint32_t& _period_x256, const uint8_t& eta_error_sd);
+
+	/* @return actual - predicted arrival time (ms) of the last packet
+	 * (positive means it arrived late) */
+	const int16_t& get_eta_error() const { return eta_error; }
+
+	/* @return RMS of get_eta_error() over the last few packets */
+	uint8_t get_eta_error_sd() const;
+
+	/* @return how long before get_eta() to start listening for this TX.
+	 * Listen for as long again after get_eta(). */
+	uint16_t get_window_open() const;
+
+	/* @return true if we're past the end of this TX's window (and that
+	 * can't be explained by millis() rolling over) */
+	bool is_overdue() const;
+
 	void print();
 
 protected:
 	void init(); // called from constructors
+
+	/* @return predicted arrival time num_periods after phase */
+	millis_t predict(const millis_t& num_periods) const;
+
 	millis_t eta; // estimated time of arrival in milliseconds since power-on
-	RollingAv sample_period;
-	uint8_t  num_periods_missed;
+
+	/* Alpha-beta filter state: filtered time of the last arrival and
+	 * the period in 1/256 ms.  Predicting from the filtered phase rather
+	 * than from a raw timecode means that neither timing jitter nor
+	 * missed periods accumulate into the ETA. */
+	millis_t phase;
+	uint32_t period_x256;
+
+	/* Squares of recent ETA errors.  Starts out as if the errors
+	 * filled the default CC_TX_WINDOW so the window only shrinks once
+	 * we've seen that this TX arrives when we expect it to. */
+	RollingAverage<8, uint16_t, uint32_t> sq_eta_error;
+	int16_t  eta_error;
+	uint8_t  num_samples; /* saturates at 0xFF */
+	uint8_t  num_periods_missed; /* eta = predict(num_periods_missed) */
+	bool     period_restored; /* period_x256 came from restore_timing() */
 	millis_t last_seen;
 };
 
 
-class CcTxArray : public DynamicArray<CcTx> {
+#ifdef ID_HASH_INDEX
+typedef IdHashIndex<CC_TX_HASH_SLOTS>  CcTxIdIndex;
+typedef IdHashIndex<CC_TRX_HASH_SLOTS> CcTrxIdIndex;
+#else
+typedef NoIdIndex CcTxIdIndex;
+typedef NoIdIndex CcTrxIdIndex;
+#endif
+
+#ifdef STATIC_ARRAYS
+typedef StaticArray<CcTx,  CC_TX_CAPACITY,  CcTxIdIndex>  CcTxArrayBase;
+typedef StaticArray<CcTrx, CC_TRX_CAPACITY, CcTrxIdIndex> CcTrxArrayBase;
+#else
+typedef DynamicArray<CcTx,  GrowGeometric, CcTxIdIndex>  CcTxArrayBase;
+typedef DynamicArray<CcTrx, GrowGeometric, CcTrxIdIndex> CcTrxArrayBase;
+#endif
+
+/**
+ * Keeps a binary min-heap of indices into data, ordered by when each
+ * TX's window opens (active TXs first), so the next TX to expect is
+ * always at the top.
+ * Use update() and current_missing() rather than calling CcTx::update()
+ * and CcTx::missing() directly so that the heap stays in order.
+ *
+ * If there are more than CC_TX_HEAP_LENGTH TXs we fall back to
+ * scanning every TX in next().
+ */
+class CcTxArray : public CcTxArrayBase {
 public:
+    /* Make the TX whose window opens first current, first calling missing()
+     * on any TX whose window has passed.  O(1) unless TXs are overdue. */
     void next();
+
+    /* Update data[index] with packet then call next().  O(log n) */
+    void update(const index_t& index, const RxPacketFromSensor& packet);
+
+    /* current() has missed its window.  Call next().  O(log n) */
+    void current_missing();
+
     void print_name() const;
+
+protected:
+    void items_changed();
+
+private:
+    bool use_heap() const { return n <= CC_TX_HEAP_LENGTH; }
+
+    /* @return true if data[a]'s window opens before data[b]'s */
+    bool earlier(const index_t& a, const index_t& b) const;
+
+    void reschedule(const index_t& index);
+    void sift_up(index_t pos);
+    void sift_down(index_t pos);
+    void swap(const index_t& pos_a, const index_t& pos_b);
+
+    index_t heap[CC_TX_HEAP_LENGTH];     /* indices into data; heap[0] is due first */
+    index_t heap_pos[CC_TX_HEAP_LENGTH]; /* data[j] is at heap[heap_pos[j]] */
 };
 
-class CcTrxArray : public DynamicArray<CcTrx> {
+/**
+ * Besides the TRXs themselves, keeps a FIFO queue of indices of TRXs
+ * which missed a poll so that retries don't have to scan every TRX.
+ *
+ * If more than CC_TRX_RETRY_QUEUE_LENGTH TRXs are waiting for a retry
+ * we fall back to scanning every TRX for inactive ones once the queue
+ * is empty.
+ */
+class CcTrxArray : public CcTrxArrayBase {
 public:
+    CcTrxArray();
     void next();
+
+    /* data[index] missed a poll: queue it for a retry.  O(1) */
+    void add_retry(const index_t& index);
+
+    /**
+     * @param index set to the TRX which has waited longest for a retry
+     * @return false if no TRX is waiting for a retry
+     */
+    bool peek_retry(index_t& index);
+
+    /* Remove the TRX returned by peek_retry() from the queue */
+    void pop_retry();
+
+    /* @return num TRXs in the queue (not counting any we'd have to scan for) */
+    const uint8_t& get_num_retries() const { return retry_n; }
+
+    void clear_retries();
+
     void print_name() const;
+
+protected:
+    void items_changed() { clear_retries(); }
+
+private:
+    index_t retry_queue[CC_TRX_RETRY_QUEUE_LENGTH]; /* ring buffer of indices into data */
+    uint8_t retry_head, retry_n;
+
+    /* The queue has overflowed since the last clear_retries() so scan
+     * data from retry_scan onwards once the queue is empty */
+    bool retry_overflow;
+    index_t retry_scan;
 };
 
 #endif /* SENSOR_H */
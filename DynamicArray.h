@@ -28,6 +28,44 @@
 
 #include "consts.h"
 #include "utils.h"
+#include "IdHashIndex.h"
+
+/**
+ * Capacity growth policies for DynamicArray.  Pick one at compile time
+ * with DynamicArray's second template parameter.
+ * next_size() returns the new capacity to allocate when the array is full.
+ * HEAP is false if the items don't live on the heap (see StaticArray.h).
+ */
+
+/* Grow one slot at a time.  Never wastes RAM but every append to a full
+ * array re-allocates and copies every item. */
+struct GrowByOne {
+    static const bool HEAP = true;
+    static index_t next_size(const index_t& size)
+    {
+        return size == (index_t)~0 ? size : size + 1;
+    }
+};
+
+/* Grow by half again (0, 1, 2, 4, 7, 11, 17, 26, ...) so re-allocations
+ * are amortised O(1) per append, at the cost of up to a third of the
+ * array being unused. */
+struct GrowGeometric {
+    static const bool HEAP = true;
+    static index_t next_size(const index_t& size)
+    {
+        const uint32_t new_size = (uint32_t)size + (size >> 1) + 1;
+        return new_size > (index_t)~0 ? (index_t)~0 : new_size;
+    }
+};
+
+/* Never grow: the items live in a fixed-size buffer which the subclass
+ * owns (see StaticArray.h) */
+struct FixedCapacity {
+    static const bool HEAP = false;
+    static index_t next_size(const index_t& size) { return size; }
+};
+
 
 /**
  * A DynamicArray template for storing multiple CcTx or CcTrx objects.
@@ -37,10 +75,14 @@
  * append operations quite costly.
  * To minimise memory fragmentation, it is best to allocate space using
  * set_size(index_t) prior to appending data to the array using append(id_t).
- * However, append(id_t) will allocate more space if n == size when append(id_t)
- * is called.
+ * However, append(id_t) will allocate more space (as dictated by growth_t)
+ * if n == size when append(id_t) is called.  To add many IDs at once, sort
+ * them and use append(const id_t*, index_t), which inserts them all in
+ * a single merge pass.
+ * id_index_t (see IdHashIndex.h) optionally indexes IDs so that find()
+ * doesn't have to search; it's rebuilt whenever items are added or removed.
  */
-template <class item_t>
+template <class item_t, class growth_t = GrowGeometric, class id_index_t = NoIdIndex>
 class DynamicArray {
 protected:
     item_t * data;
@@ -48,6 +90,7 @@ protected:
             i,    /* index of the "current" item */
             n;    /* number of items currently stored */
     id_t    min_id, max_id; /* used to speed up search */
+    id_index_t id_index;
 
 public:
     DynamicArray()
@@ -56,7 +99,9 @@ public:
 
     virtual ~DynamicArray()
     {
-        delete[] data;
+        if (growth_t::HEAP) {
+            delete[] data;
+        }
     }
 
 
@@ -65,7 +110,7 @@ public:
      *  a DynamicArray object back from a function) */
     DynamicArray(const DynamicArray& src)
     : size(src.size), i(src.size), n(src.n),
-      min_id(src.min_id), max_id(src.max_id)
+      min_id(src.min_id), max_id(src.max_id), id_index(src.id_index)
     {
         data = new item_t[size];
         if (data) {
@@ -76,7 +121,7 @@ public:
     }
 
 
-    DynamicArray<item_t>& operator=(const DynamicArray& src)
+    DynamicArray<item_t, growth_t, id_index_t>& operator=(const DynamicArray& src)
     {
         if (data) { /* check if we're overwriting some old data */
             delete [] data;
@@ -87,6 +132,7 @@ public:
         n      = src.n;
         min_id = src.min_id;
         max_id = src.max_id;
+        id_index = src.id_index;
 
         data = new item_t[size];
         if (data) {
@@ -124,6 +170,10 @@ public:
     const index_t& get_n() const { return n; }
 
 
+    /* @return number of items there's room for without re-allocating */
+    const index_t& get_size() const { return size; }
+
+
     const index_t& get_i() const { return i; }
 
 
@@ -133,8 +183,33 @@ public:
     virtual void print_name() const = 0;
 
 
+protected:
+    /* Called after items have been added or removed, so that subclasses
+     * can rebuild anything which refers to items by index. */
+    virtual void items_changed() {}
+
+
+private:
+    void items_changed_internal()
+    {
+        id_index.rebuild(data, n);
+        items_changed();
+    }
+
+
+public:
+
+
     bool set_size(const index_t& new_size)
     {
+        if (!growth_t::HEAP) { // capacity is fixed
+            if (new_size > size) {
+                log(WARN, PSTR("DYNAMIC ARRAY FULL"));
+                return false;
+            }
+            return true;
+        }
+
         item_t* new_data = new item_t[new_size];
         if (new_data) {
             size = new_size;
@@ -151,14 +226,21 @@ public:
 
 
 #ifndef TESTING
-    void set_size_from_serial()
+    /* Serial commands are handled in two halves so that Manager::run()
+     * never blocks waiting for the argument: the prompt is sent when the
+     * command character arrives and the *_from_serial(arg) method is
+     * called once the argument line is complete. */
+
+    void prompt_for_size() const
     {
         Serial.print(F("ACK enter number of "));
         print_name();
         Serial.println(F("s:"));
+    }
 
-        uint32_t new_size = utils::read_uint32_from_serial();
 
+    void set_size_from_serial(const uint32_t& new_size)
+    {
         bool success;
 
         success = new_size == UINT32_INVALID ? false : set_size(new_size);
@@ -171,14 +253,16 @@ public:
     }
 
 
-    void get_id_from_serial()
+    void prompt_for_id_to_add() const
     {
         Serial.print(F("ACK enter "));
         print_name();
         Serial.println(F(" ID to add:"));
+    }
 
-        uint32_t id = utils::read_uint32_from_serial();
 
+    void get_id_from_serial(const uint32_t& id)
+    {
         bool success;
         success = id == UINT32_INVALID ? false : append(id);
 
@@ -190,14 +274,16 @@ public:
     }
 
 
-    void remove_id_from_serial()
+    void prompt_for_id_to_remove() const
     {
         Serial.print(F("ACK enter "));
         print_name();
         Serial.println(F(" ID to remove:"));
+    }
 
-        uint32_t id = utils::read_uint32_from_serial();
 
+    void remove_id_from_serial(const uint32_t& id)
+    {
         bool success;
         success = id == UINT32_INVALID ? false : remove_id(id);
 
@@ -232,6 +318,7 @@ public:
         }
 
         n--;
+        items_changed_internal();
         return true;
     }
 
@@ -265,7 +352,8 @@ public:
             data[upper_bound] = item_t(id);
             n++;
         } else { // n == size so allocate more memory
-            item_t * new_data = new item_t[size+1];
+            const index_t new_size = growth_t::next_size(size);
+            item_t * new_data = new_size > size ? new item_t[new_size] : 0;
             if (new_data == 0) {
                 log(ERROR, PSTR("OUT OF MEMORY"));
                 return false;
@@ -277,11 +365,12 @@ public:
 
             delete[] data;
             data = new_data;
-            n = ++size;
+            size = new_size;
+            n++;
         }
 
         // Update min_id and max if necessary
-        if (size==1) {
+        if (n==1) {
             min_id = max_id = id;
         } else {
             if (id > max_id) {
@@ -291,10 +380,91 @@ public:
             }
         }
 
+        items_changed_internal();
         return true;
     }
 
 
+    /**
+     * Append a batch of IDs in one pass, re-allocating at most once.
+     *
+     * @param ids must be sorted in ascending order.  IDs which are
+     *        already in the array (or repeated in ids) are skipped.
+     * @return number of IDs added.  0 if ids isn't sorted or we're
+     *         out of memory, in which case the array is unchanged.
+     */
+    index_t append(const id_t* ids, const index_t& count)
+    {
+        /* First pass: check ids is sorted and count the new IDs */
+        index_t num_new = 0;
+        index_t j = 0; // index into data
+        for (index_t k=0; k<count; k++) {
+            if (k > 0 && ids[k] < ids[k-1]) {
+                log(WARN, PSTR("IDs to append must be sorted"));
+                return 0;
+            }
+            if (k > 0 && ids[k] == ids[k-1]) {
+                continue;
+            }
+            for (; j < n && data[j].id < ids[k]; j++)
+                ;
+            if (j == n || data[j].id != ids[k]) {
+                num_new++;
+            }
+        }
+
+        if (num_new == 0) {
+            return 0;
+        }
+
+        item_t * dst = data;
+        index_t new_size = size;
+        if ((uint32_t)n + num_new > size) {
+            new_size = growth_t::next_size(size);
+            if (new_size < n + num_new) {
+                new_size = n + num_new;
+            }
+            if (!growth_t::HEAP || new_size < n || // new_size < n if index_t overflowed
+                    (dst = new item_t[new_size]) == 0) {
+                log(ERROR, PSTR("OUT OF MEMORY"));
+                return 0;
+            }
+        }
+
+        /* Second pass: merge from the top down, so that when we're merging
+         * in place each item moves at most once and is never overwritten
+         * before it's been moved. */
+        index_t src = n;         // items [0, src) of data still to merge
+        index_t k = count;       // ids [0, k) still to merge
+        index_t out = n + num_new;
+        while (k > 0) {
+            const id_t id = ids[k-1];
+            if (k > 1 && ids[k-2] == id) {
+                k--; // skip repeats within ids
+            } else if (src > 0 && data[src-1].id > id) {
+                dst[--out] = data[--src];
+            } else if (src > 0 && data[src-1].id == id) {
+                k--; // already in data
+            } else {
+                dst[--out] = item_t(id);
+                k--;
+            }
+        }
+        if (dst != data) {
+            copy(dst, 0, 0, src); // remaining items below every new ID
+            delete[] data;
+            data = dst;
+            size = new_size;
+        }
+
+        n += num_new;
+        min_id = data[0].id;
+        max_id = data[n-1].id;
+        items_changed_internal();
+        return num_new;
+    }
+
+
     /* copy data from this.data to dst */
     void copy(item_t * dst, const index_t src_start,
             const index_t dst_start, const index_t length) const
@@ -311,6 +481,9 @@ public:
     bool find(const id_t& target_id) const
     {
         index_t index = 0;
+        if (id_index.is_enabled()) {
+            return id_index.find(target_id, data, index);
+        }
         return find(target_id, index);
     }
 
@@ -318,51 +491,97 @@ public:
     /** Attempts to find target ID in data.
      *  If target can't be found then returns false and index == upper_bound nearest target.
      *  Note that if we search for an ID that's above the largest ID in index will be
-     *  equal to n. */
+     *  equal to n.
+     *
+     *  Interpolation probes find evenly spread IDs in a couple of probes.
+     *  Whenever an interpolation probe fails to halve the range, the next
+     *  probe bisects, so the range at least halves every other probe and
+     *  clustered IDs can't make us degrade to a linear scan.
+     *  At most 2*log2(n) + 2 probes.
+     *  Uses integer arithmetic only, to keep soft-float out of the AVR image. */
     bool find(const id_t& target_id, index_t& index) const
     {
+        if (id_index.find(target_id, data, index)) {
+            return true;
+        }
+        // Not found (or no index) so search, to find the upper bound
 
-        if (target_id < min_id) {
+        if (n == 0 || target_id < min_id) {
             index = 0;
             return false;
         } else if (target_id > max_id) {
             index = n;
             return false;
         }
-        else if (n > 1) {
-            // Try to guess the candidate item position by looking at the size of target_id
-            // relative to difference of max - min.  This will give us an educated guess and
-            // then we search backwards or forwards from that starting guess.
-            float diff = max_id - min_id;
-            index = ((target_id - min_id) / diff) * (n-1);
 
-            if (index >= n) index = n;
+        index_t lo = 0, hi = n; // if target_id is in data then it's in [lo, hi)
+        bool interpolate = true;
 
-            // Search backwards
-            for (; index > 0 && data[index].id > target_id; index--)
-                ;
-
-            // Search forwards
-            for (; index < n && data[index].id < target_id; index++)
-                ;
+        while (lo < hi) {
+            const index_t width = hi - lo;
+            index_t probe;
+            if (interpolate && width > 2) {
+                probe = interpolation_probe(target_id, lo, hi);
+            } else {
+                probe = lo + (width >> 1);
+            }
 
-            return data[index].id == target_id;
-        }
-        else if (n == 1) {
-            if (target_id == operator[](0).id) {
-                index = 0;
+            if (data[probe].id < target_id) {
+                lo = probe + 1;
+            } else if (data[probe].id > target_id) {
+                hi = probe;
+            } else {
+                index = probe;
                 return true;
             }
+
+            /* Only bisect if interpolating didn't at least halve the range */
+            interpolate = !interpolate || (hi - lo) <= (width >> 1);
         }
-        return false; // should never get here (this is just to keep the compiler happy)
+
+        index = lo;
+        return false;
     }
 
 
+private:
+    /* Guess where target_id is in [lo, hi) assuming IDs are evenly spread.
+     * Both sides of the ratio are scaled down until span fits in 16 bits
+     * so that the multiplication can't overflow 32 bits. */
+    index_t interpolation_probe(const id_t& target_id,
+            const index_t& lo, const index_t& hi) const
+    {
+        const id_t lo_id = data[lo].id;
+        const id_t hi_id = data[hi-1].id;
+
+        if (target_id <= lo_id) {
+            return lo;
+        } else if (target_id >= hi_id) {
+            return hi-1;
+        }
+
+        uint32_t offset = target_id - lo_id;
+        uint32_t span = hi_id - lo_id;
+        if (span > 0xFFFFFF) { // whole-byte shifts are cheap on AVR
+            span >>= 8;
+            offset >>= 8;
+        }
+        while (span > 0xFFFF) {
+            span >>= 1;
+            offset >>= 1;
+        }
+
+        return lo + (offset * (uint32_t)(hi - 1 - lo)) / span;
+    }
+
+
+public:
     /* Don't de-allocate memory; just set n and i to 0 */
     void delete_all()
     {
         n = i = 0;
         min_id = max_id = 0;
+        items_changed_internal();
         Serial.print(F("ACK deleted all "));
         print_name();
         Serial.println(F("s"));
@@ -0,0 +1,128 @@
+/*
+ * IdHashIndex.h
+ *
+ *      Author: Jack Kelly
+ *
+ * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
+ * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
+ * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE
+ * QUALITY AND PERFORMANCE OF THE PROGRAM IS WITH YOU. SHOULD THE PROGRAM PROVE
+ * DEFECTIVE, YOU ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ */
+
+#ifndef IDHASHINDEX_H_
+#define IDHASHINDEX_H_
+
+#include "consts.h"
+
+/**
+ * Optional ID indices for DynamicArray.  Pick one at compile time with
+ * DynamicArray's third template parameter.
+ *
+ * An index maps an ID to that item's position in DynamicArray::data.
+ * DynamicArray calls rebuild() whenever items are added or removed
+ * (which is rare) so that find() (which happens for every packet) is cheap.
+ */
+
+/* No index: DynamicArray::find() always searches. Costs no RAM. */
+class NoIdIndex {
+public:
+    bool is_enabled() const { return false; }
+
+    template <class item_t>
+    void rebuild(const item_t* data, const index_t& n) {}
+
+    template <class item_t>
+    bool find(const id_t& id, const item_t* data, index_t& index) const { return false; }
+};
+
+
+/**
+ * Open-addressing hash table (linear probing) with SLOTS slots,
+ * each holding an index into DynamicArray::data.
+ *
+ * SLOTS must be a power of two.  The index only holds up to
+ * SLOTS * MAX_LOAD_PERCENT / 100 items, which bounds the length of
+ * probe sequences.  If the array grows beyond that the index disables
+ * itself and DynamicArray falls back to searching.
+ */
+template <index_t SLOTS, uint8_t MAX_LOAD_PERCENT = ID_HASH_MAX_LOAD>
+class IdHashIndex {
+public:
+    IdHashIndex(): enabled(true)
+    {
+        clear();
+    }
+
+    bool is_enabled() const { return enabled; }
+
+    template <class item_t>
+    void rebuild(const item_t* data, const index_t& n)
+    {
+        clear();
+
+        if (n > MAX_ITEMS) {
+            if (enabled) {
+                log(WARN, PSTR("Too many IDs for hash index"));
+            }
+            enabled = false;
+            return;
+        }
+        enabled = true;
+
+        for (index_t j=0; j<n; j++) {
+            index_t slot = home(data[j].id);
+            while (slots[slot] != EMPTY) {
+                slot = (slot + 1) & (SLOTS - 1);
+            }
+            slots[slot] = j;
+        }
+    }
+
+    /**
+     * @return true if id is in data.  If so then data[index].id == id
+     */
+    template <class item_t>
+    bool find(const id_t& id, const item_t* data, index_t& index) const
+    {
+        index_t slot = home(id);
+        while (slots[slot] != EMPTY) {
+            if (data[slots[slot]].id == id) {
+                index = slots[slot];
+                return true;
+            }
+            slot = (slot + 1) & (SLOTS - 1);
+        }
+        return false;
+    }
+
+private:
+    static const index_t EMPTY = (index_t)~0;
+    static const index_t MAX_ITEMS = ((uint32_t)SLOTS * MAX_LOAD_PERCENT) / 100;
+
+    /* Compile-time checks (C++03 doesn't have static_assert) */
+    typedef char slots_must_be_a_power_of_two[(SLOTS & (SLOTS - 1)) == 0 ? 1 : -1];
+    typedef char max_load_must_leave_an_empty_slot[MAX_LOAD_PERCENT < 100 ? 1 : -1];
+    typedef char slots_must_fit_in_index_t[SLOTS - 1 < EMPTY ? 1 : -1];
+
+    void clear()
+    {
+        for (index_t slot=0; slot<SLOTS; slot++) {
+            slots[slot] = EMPTY;
+        }
+    }
+
+    /* Fibonacci hashing: multiply by 2^32 / golden ratio and take
+     * some of the high bits, which spreads out sequential IDs. */
+    static index_t home(const id_t& id)
+    {
+        return ((uint32_t)(id * 2654435761UL) >> 16) & (SLOTS - 1);
+    }
+
+    index_t slots[SLOTS];
+    bool enabled;
+};
+
+#endif /* IDHASHINDEX_H_ */
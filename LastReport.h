@@ -0,0 +1,62 @@
+/*
+ * LastReport.h
+ *
+ *      Author: Jack Kelly
+ *
+ * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
+ * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
+ * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE
+ * QUALITY AND PERFORMANCE OF THE PROGRAM IS WITH YOU. SHOULD THE PROGRAM PROVE
+ * DEFECTIVE, YOU ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ */
+
+#ifndef LASTREPORT_H_
+#define LASTREPORT_H_
+
+#ifdef TESTING
+#include <inttypes.h>
+#else
+#include <Arduino.h>
+#endif
+
+#include "consts.h"
+
+/**
+ * The last reading printed for one CC TRX, and when, for report-on-change
+ * (see Manager::report_due()).  4 bytes.  Manager only allocates these
+ * while report-on-change is on.
+ */
+class LastReport {
+public:
+    LastReport(): watts(WATTS_INVALID), time_s(0) {}
+
+    /**
+     * @return true if watts (received at now_s seconds) is more than
+     * deadband watts and deadband_pct percent away from the last reading
+     * we reported, or if we haven't reported a reading for heartbeat_s
+     * seconds.  If so, watts becomes the last reported reading.
+     */
+    bool report_due(const watts_t& _watts, const uint16_t& now_s,
+            const watts_t& deadband, const uint8_t& deadband_pct,
+            const uint16_t& heartbeat_s)
+    {
+        const watts_t change = _watts > watts ? _watts - watts : watts - _watts;
+
+        if (watts == WATTS_INVALID ||
+            (change > deadband && (uint32_t)change * 100 > (uint32_t)watts * deadband_pct) ||
+            (uint16_t)(now_s - time_s) >= heartbeat_s) {
+            watts = _watts;
+            time_s = now_s;
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    watts_t  watts;  /* WATTS_INVALID if never reported */
+    uint16_t time_s; /* seconds since power-on, wraps after 18 hours */
+};
+
+#endif /* LASTREPORT_H_ */
@@ -12,8 +12,28 @@
 
 Manager::Manager()
 : auto_pair(true), pair_with(ID_INVALID), // retry_missing_trxs(false),
-  trx_retries(0), print_packets(ALL_VALID),
-  retries(0), time_to_start_next_trx_roll_call(0)  {}
+  print_packets(ALL_VALID), output_format(JSON), batch_trx_readings(false),
+  batch_open(false), batch_empty(true), batch_in_frame(false), batch_i(0),
+  batch_time(0), report_on_change(false), last_reports(NULL), num_last_reports(0),
+  report_deadband(DEFAULT_REPORT_DEADBAND),
+  report_deadband_pct(DEFAULT_REPORT_DEADBAND_PCT),
+  report_heartbeat(DEFAULT_REPORT_HEARTBEAT), readings_suppressed(0),
+  aggregate_window(0), aggregate_window_end(0), tx_aggregates(NULL),
+  trx_aggregates(NULL), num_tx_aggregated(0), num_trx_aggregated(0),
+  printing_aggregates(false), aggregate_print_i(0), aggregate_print_time(0),
+  retries(0), time_to_start_next_trx_roll_call(0), start_of_pass(true),
+  time_of_next_retry(0), time_of_last_poll(0),
+  poll_send_time(0), max_poll_interval(DEFAULT_MAX_POLL_INTERVAL),
+  airtime_reclaimed(0), pending_cmd(0), pending_cmd_deadline(0),
+  warm_start(eeprom) {}
+
+
+Manager::~Manager()
+{
+    delete[] tx_aggregates;
+    delete[] trx_aggregates;
+    delete[] last_reports;
+}
 
 
 void Manager::init()
@@ -22,6 +42,15 @@ void Manager::init()
     //      remove init()
     rfm.init();
     rfm.enable_rx();
+
+    if (warm_start.restore(cc_txs, cc_trxs, millis())) {
+        Serial.print(F("Warm start: "));
+        Serial.print(cc_txs.get_n());
+        Serial.print(F(" TXs, "));
+        Serial.print(cc_trxs.get_n());
+        Serial.println(F(" TRXs"));
+    }
+
     time_to_start_next_trx_roll_call = millis();
 }
 
@@ -30,14 +59,19 @@ void Manager::run()
 {
     using namespace utils;
     //************* HANDLE TRANSMITTERS AND TRANSCEIVERS ***********
+    /* Schedule airtime earliest deadline first.  Each CC TX window is a
+     * hard deadline: we must be listening for all of it.  TRX polls
+     * fill the gaps between windows, but only if the poll's reply is
+     * due before the next window opens (see poll_next_cc_trx()). */
     if (cc_txs.get_n() == 0) {
-        // There are no CC TXs so all we have to do is poll TRXs
-        poll_next_cc_trx();
+        // There are no CC TXs so every poll fits
+        poll_next_cc_trx(millis() + SAMPLE_PERIOD);
     } else {
-        if (in_future(cc_txs.current().get_eta() - CC_TX_WINDOW_OPEN)) {
-            // We're far enough away from the next expected CC TX transmission
-            // to mean that we have time to poll TRXs
-            poll_next_cc_trx();
+        cc_txs.next(); // skip the windows of any TXs which are overdue
+        const millis_t window_start =
+                cc_txs.current().get_eta() - cc_txs.current().get_window_open();
+        if (in_future(window_start)) {
+            poll_next_cc_trx(window_start);
         } else {
             wait_for_cc_tx();
         }
@@ -46,18 +80,54 @@ void Manager::run()
     // Make sure we always check for RX packets
     process_rx_pack_buf_and_find_id(0);
 
-    if (Serial.available()) {
-        handle_serial_commands();
-    }
+    expire_pending_polls();
+
+    handle_serial_commands();
+
+    end_aggregate_window();
+    print_aggregates();
+    continue_trx_batch();
+    serial_tx.drain();
+
+    warm_start.run(cc_txs, cc_trxs, millis());
 }
 
 
 void Manager::handle_serial_commands()
 {
-    char incomming_byte = Serial.read();
-    uint32_t input;
+    using namespace utils;
+
+    /* Replies go straight to Serial, so flush before each one.  Argument
+     * digits don't get a reply until the last. */
+    while (Serial.available()) {
+        const char incomming_byte = Serial.read();
+
+        if (pending_cmd) {
+            if (serial_arg.feed(incomming_byte)) {
+                const char cmd = pending_cmd;
+                pending_cmd = 0;
+                flush_serial_tx();
+                handle_serial_cmd_arg(cmd, serial_arg.get_value());
+            }
+        } else {
+            flush_serial_tx();
+            handle_serial_cmd(incomming_byte);
+        }
+    }
+
+    if (pending_cmd && !in_future(pending_cmd_deadline)) {
+        flush_serial_tx();
+        Serial.print(F("NAK timed out waiting for argument to '"));
+        Serial.print(pending_cmd);
+        Serial.println(F("'"));
+        pending_cmd = 0;
+    }
+}
 
-    switch (incomming_byte) {
+
+void Manager::handle_serial_cmd(const char& cmd)
+{
+    switch (cmd) {
     case 'a': auto_pair = true;  Serial.println(F("ACK auto_pair on")); break;
     case 'm': auto_pair = false; Serial.println(F("ACK auto_pair off")); break;
     case 'p':
@@ -65,29 +135,14 @@ void Manager::handle_serial_commands()
             Serial.println(F("NAK Enable manual pairing before p cmd"));
         } else {
             Serial.println(F("ACK Enter ID:"));
-            input = utils::read_uint32_from_serial();
-            if (input == UINT32_INVALID) {
-                Serial.println(F("NAK"));
-            } else {
-                pair_with = input;
-                Serial.print(F("ACK pair_with set to "));
-                Serial.println(pair_with);
-            }
+            wait_for_serial_arg(cmd);
         }
         break;
     case 'v':
 #ifdef LOGGING
         Serial.print(F("ACK enter log level: "));
         print_log_levels();
-        input = utils::read_uint32_from_serial();
-        if (input == UINT32_INVALID) {
-            Serial.println(F("NAK"));
-        } else {
-            Logger::log_threshold = (Level)input;
-            Serial.print(F("ACK Log level set to "));
-            print_log_level(Logger::log_threshold);
-            Serial.println(F(""));
-        }
+        wait_for_serial_arg(cmd);
 #else
         Serial.println(F("NAK logging disabled!"));
 #endif // LOGGING
@@ -95,81 +150,392 @@ void Manager::handle_serial_commands()
     case 'k': print_packets = ONLY_KNOWN; Serial.println(F("ACK only print data from known transmitters")); break;
     case 'u': print_packets = ALL_VALID; Serial.println(F("ACK print all valid packets")); break;
     case 'b': print_packets = ALL; Serial.println(F("ACK print all")); break;
-    case 'n': cc_txs.get_id_from_serial();  break;
-    case 'N': cc_trxs.get_id_from_serial(); break;
-    case 's': cc_txs.set_size_from_serial(); break;
-    case 'S': cc_trxs.set_size_from_serial(); break;
-    case 'd': cc_txs.delete_all();  break;
-    case 'D': cc_trxs.delete_all(); break;
-    case 'r': cc_txs.remove_id_from_serial();  break;
-    case 'R': cc_trxs.remove_id_from_serial();  break;
+    case 'j': output_format = JSON; Serial.println(F("ACK JSON output")); break;
+    case 'x': output_format = BINARY; Serial.println(F("ACK binary output")); break;
+    case 'B': batch_trx_readings = true; Serial.println(F("ACK batch TRX readings (JSON only)")); break;
+    case 'E':
+        if (batch_trx_readings) {
+            start_trx_batch(); // don't strand readings since the last batch
+        }
+        batch_trx_readings = false;
+        Serial.println(F("ACK print each reading"));
+        break;
+    case 'n': cc_txs.prompt_for_id_to_add();  wait_for_serial_arg(cmd); break;
+    case 'N': cc_trxs.prompt_for_id_to_add(); wait_for_serial_arg(cmd); break;
+    case 's': cc_txs.prompt_for_size();  wait_for_serial_arg(cmd); break;
+    case 'S': cc_trxs.prompt_for_size(); wait_for_serial_arg(cmd); break;
+    case 'd': cc_txs.delete_all();  warm_start.ids_changed(millis()); break;
+    case 'D': cc_trxs.delete_all(); warm_start.ids_changed(millis()); break;
+    case 'r': cc_txs.prompt_for_id_to_remove();  wait_for_serial_arg(cmd); break;
+    case 'R': cc_trxs.prompt_for_id_to_remove(); wait_for_serial_arg(cmd); break;
     case 'l': cc_txs.print();  break;
     case 'L': cc_trxs.print(); break;
-    case '0': change_state(0); break;
-    case '1': change_state(1); break;
+    case '0':
+    case '1':
+        Serial.print(F("ACK enter TRX to switch "));
+        Serial.println(cmd=='1' ? F("on:") : F("off:"));
+        wait_for_serial_arg(cmd);
+        break;
+    case 'i':
+        Serial.println(F("ACK enter max TRX poll interval in roll calls (1 disables adaptive polling):"));
+        wait_for_serial_arg(cmd);
+        break;
+    case 'o': report_on_change = true;  Serial.println(F("ACK report TRX readings on change")); break;
+    case 'O':
+        report_on_change = false;
+        forget_last_reports();
+        Serial.println(F("ACK report every TRX reading"));
+        break;
+    case 'w':
+        Serial.println(F("ACK enter report-on-change deadband in watts:"));
+        wait_for_serial_arg(cmd);
+        break;
+    case 'W':
+        Serial.println(F("ACK enter report-on-change deadband in percent:"));
+        wait_for_serial_arg(cmd);
+        break;
+    case 'h':
+        Serial.println(F("ACK enter report-on-change heartbeat in seconds:"));
+        wait_for_serial_arg(cmd);
+        break;
+    case 'A':
+        Serial.println(F("ACK enter aggregation window in seconds (0 disables aggregation):"));
+        wait_for_serial_arg(cmd);
+        break;
+    case 'c': print_stats(); break;
+    case 'f': print_memory(); break;
     case 't': delay(10); Serial.println(millis()); break;
     case '\r': break; // ignore carriage returns
+    case '\n': break; // and line feeds
     default:
         Serial.print(F("NAK unrecognised cmd '"));
-        Serial.print(incomming_byte);
+        Serial.print(cmd);
         Serial.println(F("'"));
         break;
     }
 }
 
 
-void Manager::poll_next_cc_trx()
+void Manager::wait_for_serial_arg(const char& cmd)
+{
+    pending_cmd = cmd;
+    pending_cmd_deadline = millis() + SERIAL_ARG_TIMEOUT;
+    serial_arg.reset();
+}
+
+
+void Manager::handle_serial_cmd_arg(const char& cmd, const uint32_t& arg)
+{
+    switch (cmd) {
+    case 'p':
+        if (arg == UINT32_INVALID) {
+            Serial.println(F("NAK"));
+        } else {
+            pair_with = arg;
+            Serial.print(F("ACK pair_with set to "));
+            Serial.println(pair_with);
+        }
+        break;
+    case 'v':
+#ifdef LOGGING
+        if (arg == UINT32_INVALID) {
+            Serial.println(F("NAK"));
+        } else {
+            Logger::log_threshold = (Level)arg;
+            Serial.print(F("ACK Log level set to "));
+            print_log_level(Logger::log_threshold);
+            Serial.println(F(""));
+        }
+#endif // LOGGING
+        break;
+    case 'i':
+        if (arg == UINT32_INVALID || arg == 0 || arg > 0x80) {
+            Serial.println(F("NAK"));
+        } else {
+            // Intervals double so round down to a power of two
+            max_poll_interval = 1;
+            while ((uint32_t)max_poll_interval << 1 <= arg) {
+                max_poll_interval <<= 1;
+            }
+            Serial.print(F("ACK max TRX poll interval set to "));
+            Serial.println(max_poll_interval);
+        }
+        break;
+    case 'w':
+        if (arg >= WATTS_INVALID) {
+            Serial.println(F("NAK"));
+        } else {
+            report_deadband = arg;
+            Serial.print(F("ACK deadband set to "));
+            Serial.print(report_deadband);
+            Serial.println(F(" W"));
+        }
+        break;
+    case 'W':
+        if (arg > 100) {
+            Serial.println(F("NAK"));
+        } else {
+            report_deadband_pct = arg;
+            Serial.print(F("ACK deadband set to "));
+            Serial.print(report_deadband_pct);
+            Serial.println(F("%"));
+        }
+        break;
+    case 'h':
+        if (arg == 0 || arg > 0xFFFF) {
+            Serial.println(F("NAK"));
+        } else {
+            report_heartbeat = arg;
+            Serial.print(F("ACK heartbeat set to "));
+            Serial.print(report_heartbeat);
+            Serial.println(F(" s"));
+        }
+        break;
+    case 'A':
+        if (arg > 0xFFFF) {
+            Serial.println(F("NAK"));
+        } else if (!start_aggregating(arg)) {
+            Serial.println(F("NAK out of memory"));
+        } else {
+            Serial.print(F("ACK aggregation window set to "));
+            Serial.print(aggregate_window);
+            Serial.println(F(" s"));
+        }
+        break;
+    case 'n': cc_txs.get_id_from_serial(arg);  break;
+    case 'N': cc_trxs.get_id_from_serial(arg); break;
+    case 's': cc_txs.set_size_from_serial(arg); break;
+    case 'S': cc_trxs.set_size_from_serial(arg); break;
+    case 'r': cc_txs.remove_id_from_serial(arg);  break;
+    case 'R': cc_trxs.remove_id_from_serial(arg);  break;
+    case '0': change_state(0, arg); break;
+    case '1': change_state(1, arg); break;
+    }
+
+    if (strchr("nNrR", cmd)) {
+        warm_start.ids_changed(millis());
+        forget_last_reports(); // indices have moved
+    }
+
+    /* Adding or removing sensors moves their indices */
+    if (aggregate_window && strchr("nNsSrR", cmd)) {
+        start_aggregating(aggregate_window);
+    }
+}
+
+
+void Manager::poll_next_cc_trx(const millis_t& deadline)
 {
     if (cc_trxs.get_n() == 0) return;
 
     using namespace utils;
 
-	if (cc_trxs.get_i()==0) {
-	    /* The code in this block will be executed once per TRX roll call,
-	     * at the start of the roll call. */
+	if (start_of_pass) {
+	    /* The code in this block will be executed at the start of each
+	     * pass through cc_trxs.  (Not every time get_i()==0: we often
+	     * come back to the first TRX without polling it.) */
 
 		if (in_future(time_to_start_next_trx_roll_call)) {
 		    /* We've finished the first pass of polling
 		     * all TRXs for this SAMPLE_PERIOD.
-		     * So now poll the missing TRXs. */
-		    if (trx_retries < MAX_RETRIES) {
-		        trx_retries++;
-		    }
-		} else {
-		    /* Time to start the first pass of another TRX roll call. */
-			time_to_start_next_trx_roll_call = millis() + SAMPLE_PERIOD;
-			trx_retries = 0;
+		     * So now retry the missing TRXs. */
+		    retry_next_cc_trx(deadline);
+		    return;
+		}
+
+		/* Time to start the first pass of another TRX roll call,
+		 * once every poll from the last one is answered or expired. */
+		if (!pending_polls.empty()) {
+		    return;
 		}
+		if (batch_trx_readings) {
+		    start_trx_batch(); // replies to the roll call which just ended
+		}
+		time_to_start_next_trx_roll_call = millis() + SAMPLE_PERIOD;
+		time_of_next_retry = millis();
+		cc_trxs.clear_retries();
+		start_of_pass = false;
 	}
 
-	/* Now actually poll the current TRX if necessary.
-	 * Either trx_retries==0 (this is the first attempt to poll TRXs this period)
-	 * or this trx is inactive so we need to retry it. */
-    if (trx_retries==0 || // This is the first run this period
-       (!cc_trxs.current().active && trx_retries < MAX_RETRIES)) {
+	/* Now actually poll the current TRX if necessary, i.e. unless it's
+	 * sitting this roll call out (see adaptive polling in
+	 * CcTrx::update_poll_interval() and demotion in CcTrx::missed_poll()). */
+    if (cc_trxs.current().due_for_poll()) {
+        if (!try_to_poll(cc_trxs.current(), deadline)) {
+            return; // try the same TRX again next time round run()
+        }
+    } else {
+        cc_trxs.current().sit_out_roll_call();
+        if (cc_trxs.current().is_demoted()) {
+            // Without demotion we'd have waited for this TRX to time out
+            airtime_reclaimed += cc_trxs.current().get_timeout();
+        }
+    }
+    cc_trxs.next();
+    start_of_pass = (cc_trxs.get_i() == 0);
+}
+
 
-        poll_cc_trx(cc_trxs.current().id);
-        cc_trxs.current().active = wait_for_response(cc_trxs.current().id, CC_TRX_TIMEOUT);
+void Manager::retry_next_cc_trx(const millis_t& deadline)
+{
+    using namespace utils;
 
-        if (cc_trxs.current().active) {
-            delay(INTER_TRX_DELAY); // Wait so we don't completely saturate the airwaves.
+    index_t index;
+    while (cc_trxs.peek_retry(index)) {
+        const CcTrx& trx = cc_trxs[index];
+        if (trx.active || trx.is_demoted() || pending_polls.contains(trx.id)) {
+            cc_trxs.pop_retry(); // late reply, given up, or already retried
+        } else {
+            break;
         }
     }
-    cc_trxs.next();
+
+    if (!cc_trxs.peek_retry(index) || in_future(time_of_next_retry) ||
+        !try_to_poll(cc_trxs[index], deadline)) {
+        return;
+    }
+    cc_trxs.pop_retry();
+
+    /* Spread the queued retries over the next 1/RETRY_SPREAD of the
+     * period rather than bunching them up straight after the first pass.
+     * The rest of the period is left for TRXs which miss their retry. */
+    const millis_t now = millis();
+    time_of_next_retry = now + (time_to_start_next_trx_roll_call - now) /
+            (RETRY_SPREAD * (cc_trxs.get_num_retries() + 1));
+}
+
+
+bool Manager::try_to_poll(CcTrx& trx, const millis_t& deadline)
+{
+    using namespace utils;
+
+    /* Our own transmission would collide with a reply that's still
+     * on its way, so only send another poll once every pending poll
+     * is overdue (see CcTrx::get_timeout()).  A late reply still gets
+     * matched until it expires after CC_TRX_TIMEOUT.
+     * Don't start a poll unless its reply is due before deadline. */
+    const millis_t now = millis();
+    const uint8_t timeout = trx.get_timeout();
+    if (pending_polls.full() || in_future(time_of_last_poll + INTER_TRX_DELAY) ||
+        pending_polls.awaiting_reply(now) ||
+        (int32_t)(deadline - now) < poll_send_time + timeout) {
+        return false;
+    }
+
+    poll_cc_trx(trx.id);
+    time_of_last_poll = millis();
+    poll_send_time = time_of_last_poll - now;
+    pending_polls.add(trx.id, time_of_last_poll, timeout);
+    trx.active = false; // until it replies
+    return true;
+}
+
+
+void Manager::expire_pending_polls()
+{
+    id_t id;
+    index_t i;
+    while (pending_polls.expire(millis(), CC_TRX_TIMEOUT, id)) {
+        log(DEBUG, PSTR("Poll of %lu timed out"), id);
+        if (cc_trxs.find(id, i)) {
+            cc_trxs[i].missed_poll();
+            if (!cc_trxs[i].is_demoted()) {
+                cc_trxs.add_retry(i);
+            }
+        }
+    }
+}
+
+
+void Manager::print_stats() const
+{
+    index_t demoted = 0;
+    for (index_t i=0; i<cc_trxs.get_n(); i++) {
+        demoted += cc_trxs[i].is_demoted();
+    }
+
+    Serial.print(F("{\"demoted_trxs\": "));
+    Serial.print(demoted);
+    Serial.print(F(", \"airtime_reclaimed_ms\": "));
+    Serial.print(airtime_reclaimed);
+    Serial.print(F(", \"rx_enqueued\": "));
+    Serial.print(RxPacketFromSensor::ready_packets.get_num_enqueued());
+    Serial.print(F(", \"rx_dropped\": "));
+    Serial.print(RxPacketFromSensor::ready_packets.get_num_dropped());
+    Serial.print(F(", \"rx_high_water\": "));
+    Serial.print(RxPacketFromSensor::ready_packets.get_high_water());
+    Serial.print(F(", \"rx_buffer_full\": "));
+    Serial.print(RxPacketFromSensor::ready_packets.get_num_full());
+    Serial.print(F(", \"readings_suppressed\": "));
+    Serial.print(readings_suppressed);
+    Serial.print(F(", \"tx_deferred\": "));
+    Serial.print(serial_tx.get_num_deferred());
+    Serial.print(F(", \"tx_blocked\": "));
+    Serial.print(serial_tx.get_num_blocked());
+    Serial.print(F(", \"tx_high_water\": "));
+    Serial.print(serial_tx.get_high_water());
+    Serial.print(F(", \"eeprom_saves\": "));
+    Serial.print(warm_start.get_num_saves());
+    Serial.print(F(", \"eeprom_bytes_written\": "));
+    Serial.print(warm_start.get_num_bytes_written());
+    Serial.println(F("}"));
+}
+
+
+/* @return bytes between the top of the heap and the top of the stack
+ * (not counting holes in the heap), or -1 if we can't tell */
+static int free_ram()
+{
+#ifdef __AVR__
+    extern int __heap_start, *__brkval;
+    int top_of_stack;
+    return (int)&top_of_stack - (__brkval == 0 ? (int)&__heap_start : (int)__brkval);
+#else
+    return -1;
+#endif
+}
+
+
+void Manager::print_memory() const
+{
+    Serial.print(F("{\"free_ram\": "));
+    Serial.print(free_ram());
+    Serial.print(F(", \"static_arrays\": "));
+#ifdef STATIC_ARRAYS
+    Serial.print(1);
+#else
+    Serial.print(0);
+#endif
+    Serial.print(F(", \"cc_txs\": {\"n\": "));
+    Serial.print(cc_txs.get_n());
+    Serial.print(F(", \"capacity\": "));
+    Serial.print(cc_txs.get_size());
+    Serial.print(F(", \"item_bytes\": "));
+    Serial.print(sizeof(CcTx));
+    Serial.print(F("}, \"cc_trxs\": {\"n\": "));
+    Serial.print(cc_trxs.get_n());
+    Serial.print(F(", \"capacity\": "));
+    Serial.print(cc_trxs.get_size());
+    Serial.print(F(", \"item_bytes\": "));
+    Serial.print(sizeof(CcTrx));
+    Serial.println(F("}}"));
 }
 
 
 void Manager::wait_for_cc_tx()
 {
+    using namespace utils;
+
     // listen for TX for defined period.
     log(DEBUG, PSTR("Win open!Expecting %lu at %lu"), cc_txs.current().id, cc_txs.current().get_eta());
-    bool success = wait_for_response(cc_txs.current().id, CC_TX_WINDOW);
+    const millis_t window_end = cc_txs.current().get_eta() + cc_txs.current().get_window_open();
+    bool success = in_future(window_end) &&
+            wait_for_response(cc_txs.current().id, window_end - millis());
     log(DEBUG, PSTR("Win closed.success=%d"), success);
 
     if (!success) {
         // tell whole-house TX it missed its slot
-        cc_txs.current().missing();
-        cc_txs.next();
+        cc_txs.current_missing();
     }
 }
 
@@ -183,6 +549,9 @@ bool Manager::wait_for_response(const id_t& id, const millis_t& wait_duration)
 
     log(DEBUG, PSTR("Waiting %lu ms for ID %lu"), wait_duration, id);
     while (in_future(end_time)) {
+        print_aggregates(); // while we've nothing better to do
+        continue_trx_batch();
+        serial_tx.drain();
         if (process_rx_pack_buf_and_find_id(id)) {
             // We got a reply from the TRX we polled
             success = true;
@@ -200,67 +569,87 @@ bool Manager::process_rx_pack_buf_and_find_id(const id_t& target_id)
 	id_t id;
 	RxPacketFromSensor* packet = NULL; // just using this pointer to make code more readable
 
-	/* Loop through every packet in packet buffer. If it's done then post-process it
-	 * and then check if it's valid.  If so then handle the different types of
-	 * packet.  Finally reset the packet and return.
+	/* Visit each packet the ISR has finished receiving, in the order they
+	 * arrived (see RxPacketFromSensor::ready_packets).  Check if it's
+	 * valid.  If so then handle the different types of packet.  Finally
+	 * reset the packet, handing it back to the ISR, and return.
 	 */
-	for (index_t packet_i=0; packet_i<PACKET_BUF_LENGTH; packet_i++) {
-
-		packet = &rfm.rx_packet_buffer.packets[packet_i];
-		if (packet->done()) {
-            tx_type = packet->get_tx_type();
-			if (packet->is_ok()) {
-	            id = packet->get_id();
-                success |= (id == target_id); // Was this the packet we were looking for?
-
-				//******** PAIRING REQUEST **********************
-				if (packet->is_pairing_request()) {
-				    packet->reset();
-				    handle_pair_request(*packet);
-				    break;
-				}
-
-				//********* CC TX (transmit-only sensor) ********
-				switch (tx_type) {
-				case CCTX:
-				    bool found;
-				    index_t cc_tx_i;
-				    found = cc_txs.find(id, cc_tx_i);
-				    if (found) { // received ID is a CC_TX id we know about
-                        packet->print_id_and_watts(); // send data over serial
-				        cc_txs[cc_tx_i].update(*packet);
-				        cc_txs.next();
-				    } else {
-				        log(INFO, PSTR("Rx'd CC_TX packet w unknown ID %lu"), id);
-				        if (print_packets >= ALL_VALID) {
-				            packet->print_id_and_watts(); // send data over serial
-				        }
-				    }
-				    break;
-				case CCTRX:
-				    //****** CC TRX (transceiver; e.g. EDF IAM) ******
-				    if (cc_trxs.find(id)) {
-				        // Received ID is a CC_TRX id we know about
-				        packet->print_id_and_watts(id == target_id); // send data over serial
-				    }
-				    //********* UNKNOWN TRX ID *************************
-				    else {
-				        log(INFO, PSTR("Rx'd CC_TRX packet w unknown ID %lu"), id);
-				        if (print_packets >= ALL_VALID) {
-				            packet->print_id_and_watts(); // send data over serial
-				        }
-				    }
-				    break;
-				}
-
-			} else { // packet is not OK
-				log(INFO, PSTR("Rx'd broken %s packet"), tx_type==CCTX ? "TX" : "TRX");
-				if (print_packets == ALL) {
-				    packet->print_bytes();
-				}
+	while (RxPacketFromSensor::ready_packets.pop(packet)) {
+	    packet->decode();
+        tx_type = packet->get_tx_type();
+		if (packet->is_ok()) {
+            id = packet->get_id();
+            success |= (id == target_id); // Was this the packet we were looking for?
+
+			//******** PAIRING REQUEST **********************
+			if (packet->is_pairing_request()) {
+			    /* Reset *after* handling: ack_cc_trx() delays and the
+			     * ISR would otherwise re-use this packet meanwhile. */
+			    handle_pair_request(*packet);
+			    packet->reset();
+			    break;
+			}
+
+			//********* CC TX (transmit-only sensor) ********
+			switch (tx_type) {
+			case CCTX:
+			    bool found;
+			    index_t cc_tx_i;
+			    found = cc_txs.find(id, cc_tx_i);
+			    if (found) { // received ID is a CC_TX id we know about
+			        if (!aggregate_reading(*packet, cc_tx_i)) {
+			            print_reading(*packet); // send data over serial
+			        }
+			        cc_txs.update(cc_tx_i, *packet);
+			    } else {
+			        log(INFO, PSTR("Rx'd CC_TX packet w unknown ID %lu"), id);
+			        if (print_packets >= ALL_VALID) {
+			            print_reading(*packet); // send data over serial
+			        }
+			    }
+			    break;
+			case CCTRX:
+			    //****** CC TRX (transceiver; e.g. EDF IAM) ******
+			    index_t cc_trx_i;
+			    if (cc_trxs.find(id, cc_trx_i)) {
+			        // Received ID is a CC_TRX id we know about
+			        cc_trxs[cc_trx_i].heard();
+			        millis_t sent_at;
+			        const bool reply_to_poll = pending_polls.remove(id, sent_at);
+			        if (reply_to_poll) {
+			            cc_trxs[cc_trx_i].active = true;
+			            cc_trxs[cc_trx_i].add_rtt_sample(packet->get_timecode() - sent_at);
+			            cc_trxs[cc_trx_i].update_poll_interval(packet->get_watts()[0],
+			                    max_poll_interval);
+			        }
+			        if (aggregate_reading(*packet, cc_trx_i)) {
+			            // printed at the end of the window
+			        } else if (!report_due(*packet, cc_trx_i)) {
+			            readings_suppressed++; // hasn't changed enough to print
+			        } else if (reply_to_poll && batch_trx_readings && output_format == JSON) {
+			            cc_trxs[cc_trx_i].unreported = true; // see start_trx_batch()
+			        } else {
+			            print_reading(*packet, reply_to_poll); // send data over serial
+			        }
+			    }
+			    //********* UNKNOWN TRX ID *************************
+			    else {
+			        log(INFO, PSTR("Rx'd CC_TRX packet w unknown ID %lu"), id);
+			        if (print_packets >= ALL_VALID) {
+			            print_reading(*packet); // send data over serial
+			        }
+			    }
+			    break;
+			}
+
+		} else { // packet is not OK
+			log(INFO, PSTR("Rx'd broken %s packet"), tx_type==CCTX ? "TX" : "TRX");
+			if (print_packets == ALL) {
+			    flush_serial_tx();
+			    packet->print_bytes();
 			}
-	        packet->reset();
 		}
+	    packet->reset();
 	}
 
 	return success;
@@ -289,13 +678,283 @@ void Manager::handle_pair_request(const RxPacketFromSensor& packet)
         pair(packet);
     } else {
         // Manual pair mode. Tell user about pair request.
-        Serial.print(F("{\"pr\": "));
+        split_trx_batch();
+        serial_tx.print(F("{\"pr\": "));
         packet.print_id_and_type(true);
-        Serial.println(F("}"));
+        serial_tx.println(F("}"));
+    }
+}
+
+
+void Manager::print_reading(const RxPacketFromSensor& packet,
+        const bool reply_to_poll)
+{
+    split_trx_batch();
+    switch (output_format) {
+    case JSON: packet.print_id_and_watts(reply_to_poll); break;
+    case BINARY: packet.print_binary(reply_to_poll); break;
     }
 }
 
 
+void Manager::start_trx_batch()
+{
+    continue_trx_batch(true); // finish the last one first
+
+    batch_open = true;
+    batch_empty = true;
+    batch_i = 0;
+    batch_time = millis();
+}
+
+
+void Manager::continue_trx_batch(const bool wait)
+{
+    /* {"type": "trx_batch", "t": 4294967295, "readings": { */
+    const uint8_t MAX_HEADER_LENGTH = 53;
+    /* , "4294967295": 65535 */
+    const uint8_t MAX_READING_LENGTH = 21;
+    /* Leave room for a JSON reading from RxPacketFromSensor which
+     * arrives meanwhile, without blocking */
+    const uint8_t HEADROOM = 100;
+
+    if (!batch_open) {
+        return;
+    }
+
+    for (; batch_i < cc_trxs.get_n(); batch_i++) {
+        CcTrx& trx = cc_trxs[batch_i];
+        if (!trx.unreported) {
+            continue;
+        }
+        const uint8_t length = MAX_READING_LENGTH + HEADROOM +
+                (batch_in_frame ? 0 : MAX_HEADER_LENGTH);
+        if (!wait && serial_tx.get_room() < length) {
+            return; // carry on next time round run()
+        }
+
+        trx.unreported = false;
+        if (batch_in_frame) {
+            serial_tx.print(F(", "));
+        } else {
+            print_trx_batch_header();
+        }
+        serial_tx.print('"');
+        serial_tx.print(trx.id);
+        serial_tx.print(F("\": "));
+        serial_tx.print(trx.get_last_watts());
+        batch_empty = false;
+    }
+
+    if (batch_empty) {
+        print_trx_batch_header(); // one frame per roll call, even if empty
+    }
+    split_trx_batch();
+    batch_open = false;
+}
+
+
+void Manager::split_trx_batch()
+{
+    if (batch_in_frame) {
+        serial_tx.println(F("}}"));
+        batch_in_frame = false;
+    }
+}
+
+
+void Manager::print_trx_batch_header()
+{
+    serial_tx.print(F("{\"type\": \"trx_batch\", \"t\": "));
+    serial_tx.print(batch_time);
+    serial_tx.print(F(", \"readings\": {"));
+    batch_in_frame = true;
+}
+
+
+void Manager::flush_serial_tx()
+{
+    split_trx_batch(); // the rest of the batch follows in another frame
+    serial_tx.flush();
+}
+
+
+bool Manager::report_due(const RxPacketFromSensor& packet, const index_t& index)
+{
+    if (!report_on_change) {
+        return true;
+    }
+
+    if (last_reports == NULL || num_last_reports != cc_trxs.get_n()) {
+        forget_last_reports();
+        last_reports = new LastReport[cc_trxs.get_n()];
+        if (last_reports == NULL) {
+            log(ERROR, PSTR("OUT OF MEMORY"));
+            return true;
+        }
+        num_last_reports = cc_trxs.get_n();
+    }
+
+    return last_reports[index].report_due(packet.get_watts()[0],
+            packet.get_timecode() / 1000, report_deadband,
+            report_deadband_pct, report_heartbeat);
+}
+
+
+void Manager::forget_last_reports()
+{
+    delete[] last_reports;
+    last_reports = NULL;
+    num_last_reports = 0;
+}
+
+
+bool Manager::start_aggregating(const uint16_t window)
+{
+    delete[] tx_aggregates;
+    delete[] trx_aggregates;
+    tx_aggregates = trx_aggregates = NULL;
+    printing_aggregates = false;
+    aggregate_window = 0;
+
+    if (window == 0) {
+        return true;
+    }
+
+    num_tx_aggregated = cc_txs.get_n();
+    num_trx_aggregated = cc_trxs.get_n();
+    if (num_tx_aggregated) {
+        tx_aggregates = new SensorAggregate[num_tx_aggregated * 3];
+    }
+    if (num_trx_aggregated) {
+        trx_aggregates = new SensorAggregate[num_trx_aggregated];
+    }
+    if ((num_tx_aggregated && tx_aggregates == NULL) ||
+        (num_trx_aggregated && trx_aggregates == NULL)) {
+        delete[] tx_aggregates;
+        delete[] trx_aggregates;
+        tx_aggregates = trx_aggregates = NULL;
+        log(ERROR, PSTR("OUT OF MEMORY"));
+        return false;
+    }
+
+    aggregate_window = window;
+    aggregate_window_end = millis() + (millis_t)window * 1000;
+    return true;
+}
+
+
+bool Manager::aggregate_reading(const RxPacketFromSensor& packet, const index_t& index)
+{
+    if (aggregate_window == 0) {
+        return false;
+    }
+
+    /* Sensors have been added or removed so indices have moved.
+     * Start again with aggregates to match. */
+    if (num_tx_aggregated != cc_txs.get_n() || num_trx_aggregated != cc_trxs.get_n()) {
+        if (!start_aggregating(aggregate_window)) {
+            return false;
+        }
+    }
+
+    const watts_t* watts = packet.get_watts();
+    if (packet.get_tx_type() == CCTX) {
+        for (uint8_t sensor=0; sensor<3; sensor++) {
+            tx_aggregates[index*3 + sensor].add(watts[sensor]);
+        }
+    } else {
+        trx_aggregates[index].add(watts[0]);
+    }
+    return true;
+}
+
+
+void Manager::end_aggregate_window()
+{
+    using namespace utils;
+
+    if (aggregate_window == 0 || in_future(aggregate_window_end)) {
+        return;
+    }
+
+    /* The last window is still printing: finish it before its cursor
+     * and t are reused, or its remaining sensors would be reported
+     * merged into this window. */
+    if (printing_aggregates) {
+        print_aggregates(true);
+        if (aggregate_window == 0 || in_future(aggregate_window_end)) {
+            return; // print_aggregates() had to start aggregating again
+        }
+    }
+
+    /* Readings for sensors which print_aggregates() hasn't got to yet
+     * count towards the window it's printing; it's only ever a few. */
+    printing_aggregates = true;
+    aggregate_print_i = 0;
+    aggregate_print_time = aggregate_window_end;
+    aggregate_window_end += (millis_t)aggregate_window * 1000;
+}
+
+
+void Manager::print_aggregates(const bool wait)
+{
+    /* {"type": "trx", "id": 4294967295, "sensor": 1, "t": 4294967295,
+     *  "window_s": 65535, "n": 65535, "min": 65535, "mean": 65535,
+     *  "max": 65535, "mwh": 4294967295}\r\n */
+    const uint8_t MAX_SUMMARY_LENGTH = 152;
+
+    if (!printing_aggregates) {
+        return;
+    }
+
+    if (num_tx_aggregated != cc_txs.get_n() || num_trx_aggregated != cc_trxs.get_n()) {
+        start_aggregating(aggregate_window); // indices have moved
+        return;
+    }
+
+    const uint16_t num_sensors = num_tx_aggregated * 3 + num_trx_aggregated;
+    for (; aggregate_print_i < num_sensors; aggregate_print_i++) {
+        const bool tx = aggregate_print_i < num_tx_aggregated * 3;
+        SensorAggregate& aggregate = tx ?
+                tx_aggregates[aggregate_print_i] :
+                trx_aggregates[aggregate_print_i - num_tx_aggregated * 3];
+        if (aggregate.n == 0) {
+            continue;
+        }
+        if (!wait && serial_tx.get_room() < MAX_SUMMARY_LENGTH) {
+            return; // carry on next time round run()
+        }
+
+        split_trx_batch();
+        serial_tx.print(tx ? F("{\"type\": \"tx\", \"id\": ") : F("{\"type\": \"trx\", \"id\": "));
+        serial_tx.print(tx ? cc_txs[aggregate_print_i / 3].id :
+                cc_trxs[aggregate_print_i - num_tx_aggregated * 3].id);
+        serial_tx.print(F(", \"sensor\": "));
+        serial_tx.print(tx ? aggregate_print_i % 3 + 1 : 1);
+        serial_tx.print(F(", \"t\": "));
+        serial_tx.print(aggregate_print_time);
+        serial_tx.print(F(", \"window_s\": "));
+        serial_tx.print(aggregate_window);
+        serial_tx.print(F(", \"n\": "));
+        serial_tx.print(aggregate.n);
+        serial_tx.print(F(", \"min\": "));
+        serial_tx.print(aggregate.min);
+        serial_tx.print(F(", \"mean\": "));
+        serial_tx.print(aggregate.get_mean());
+        serial_tx.print(F(", \"max\": "));
+        serial_tx.print(aggregate.max);
+        serial_tx.print(F(", \"mwh\": "));
+        serial_tx.print(aggregate.get_mwh(aggregate_window));
+        serial_tx.println(F("}"));
+
+        aggregate.reset();
+    }
+
+    printing_aggregates = false;
+}
+
+
 void Manager::pair(const RxPacketFromSensor& packet)
 {
     bool success = false;
@@ -313,21 +972,19 @@ void Manager::pair(const RxPacketFromSensor& packet)
     }
 
     if (success) {
-        Serial.print(F("{\"pw\": "));
+        warm_start.ids_changed(millis());
+        split_trx_batch();
+        serial_tx.print(F("{\"pw\": "));
         packet.print_id_and_type(true);
-        Serial.println(F(" }"));
+        serial_tx.println(F(" }"));
     }
 
     pair_with = ID_INVALID; // reset
 }
 
-void Manager::change_state(const bool state)
+void Manager::change_state(const bool state, const id_t& id_to_switch)
 {
 #ifndef TESTING
-    Serial.print(F("ACK enter TRX to switch "));
-    Serial.println(state ? F("on:") : F("off:"));
-
-    const id_t id_to_switch = utils::read_uint32_from_serial();
     if (id_to_switch == UINT32_INVALID) {
         Serial.println(F("NAK"));
         return;
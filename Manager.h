@@ -7,16 +7,31 @@
  *  This class runs the show.  It is responsible for:
  *
  *    - Polling TRXs in sequence (a "roll call")
- *       - retrying MAX_RETRIES times if no response is received
+ *       - up to MAX_PENDING_POLLS polls can be awaiting a reply at once;
+ *         replies are matched by TRX ID as they arrive
+ *       - retrying TRXs which didn't respond, spread across whatever is
+ *         left of the SAMPLE_PERIOD, until they've missed
+ *         TRX_DEMOTE_AFTER_MISSES polls in a row
+ *       - demoting those TRXs to an exponentially backed-off probe
+ *         schedule
+ *       - optionally polling TRXs whose readings are stable less often
  *       - ensure we only do one roll call per SAMPLE_PERIOD
  *
  *    - Listening for TXs.
  *       - We try to learn when TXs are expected to arrive so we can pause
- *         TRX polling for CC_TX_WINDOW milliseconds to minimise
- *         the chances of an RF collision.
+ *         TRX polling for a window around each TX's ETA to minimise
+ *         the chances of an RF collision.  Each TX's window is as wide
+ *         as its timing jitter requires, up to CC_TX_WINDOW milliseconds.
+ *
+ *    - Sharing the airwaves earliest deadline first: CC TX windows must
+ *      be listened to in full; TRX polls fill the gaps between them, but
+ *      a poll is only sent if its reply is due before the next window.
  *
  *    - Listening for commands from the serial port.
  *
+ *    - Sending readings through serial_tx, which only writes as much as
+ *      the UART can take without blocking (see SerialTx).
+ *
  * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
  * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
  * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
@@ -33,10 +48,17 @@
 #include <Rfm12b.h>
 #include "RxPacketFromSensor.h"
 #include "CcTx.h"
+#include "SerialArgParser.h"
+#include "PendingPolls.h"
+#include "SerialTx.h"
+#include "SensorAggregate.h"
+#include "LastReport.h"
+#include "WarmStart.h"
 
 class Manager {
 public:
 	Manager();
+	~Manager();
 	void init();
 	void run();
 private:
@@ -46,7 +68,6 @@ private:
     id_t pair_with; /* radio ID to pair with */
 
     // bool retry_missing_trxs;
-    uint8_t trx_retries;
 
     enum {
         ONLY_KNOWN, /* Only print packets we know about */
@@ -54,6 +75,43 @@ private:
         ALL         /* Print all packets, including broken ones */
     } print_packets;
 
+    enum {
+        JSON,   /* One JSON object per line (default) */
+        BINARY  /* COBS-framed records. See RxPacketFromSensor::print_binary() */
+    } output_format;
+
+    /* Print each roll call's TRX replies as one JSON frame, at the start
+     * of the next roll call, instead of one line per reply */
+    bool batch_trx_readings;
+    bool batch_open;      /* continue_trx_batch() has more to write */
+    bool batch_empty;     /* no readings in the open batch yet */
+    bool batch_in_frame;  /* the current batch frame needs closing */
+    index_t batch_i;      /* next TRX for continue_trx_batch() to look at */
+    millis_t batch_time;  /* when the batch started */
+
+    /* Report-on-change: only print TRX readings which have moved outside
+     * the deadband, or for which the heartbeat is due.  See report_due().
+     * last_reports are only allocated while report-on-change is on. */
+    bool report_on_change;
+    LastReport* last_reports;      /* 1 per CC TRX, in cc_trxs order */
+    index_t num_last_reports;      /* cc_trxs.get_n() at allocation */
+    watts_t report_deadband;       /* watts */
+    uint8_t report_deadband_pct;   /* percent */
+    uint16_t report_heartbeat;     /* seconds */
+    uint32_t readings_suppressed;  /* TRX readings not printed */
+
+    /* Aggregation: instead of printing each reading from a known sensor,
+     * print each sensor's min, mean, max and energy once per window.
+     * The aggregates are only allocated while aggregation is on. */
+    uint16_t aggregate_window;         /* seconds; 0 means off */
+    millis_t aggregate_window_end;
+    SensorAggregate* tx_aggregates;    /* 3 per CC TX, in cc_txs order */
+    SensorAggregate* trx_aggregates;   /* 1 per CC TRX, in cc_trxs order */
+    index_t num_tx_aggregated, num_trx_aggregated; /* cc_txs/cc_trxs.get_n() at allocation */
+    bool printing_aggregates;          /* print_aggregates() has more to print */
+    uint16_t aggregate_print_i;        /* next sensor for print_aggregates() */
+    millis_t aggregate_print_time;     /* end of the window being printed */
+
 	/*****************************************
 	 * CC TX (e.g. whole-house transmitters) *
 	 *****************************************/
@@ -69,24 +127,85 @@ private:
 	/* We need to keep track of when we started the TRX roll call so we can
 	 * ensure that we only do one roll call per SAMPLE_PERIOD */
 	millis_t time_to_start_next_trx_roll_call;
+	bool start_of_pass; /* poll_next_cc_trx() hasn't started this pass through cc_trxs yet */
+	millis_t time_of_next_retry; /* don't send another retry before this */
+
+	/* Polls we've sent which haven't been answered or timed out yet */
+	PendingPolls pending_polls;
+	millis_t time_of_last_poll;
+	uint8_t poll_send_time; /* how long poll_cc_trx() took last time */
+
+	/* TRXs with stable readings are polled every max_poll_interval roll
+	 * calls at most.  1 polls every TRX every roll call. */
+	uint8_t max_poll_interval;
+
+	/* Estimate of how long (ms) we'd have spent waiting for demoted TRXs
+	 * to time out if we'd kept polling them.  See CcTrx::missed_poll(). */
+	uint32_t airtime_reclaimed;
+
+	/*****************************************
+	 * Serial commands                       *
+	 *****************************************/
+	char pending_cmd; /* command waiting for its argument, or 0 if none */
+	SerialArgParser serial_arg;
+	millis_t pending_cmd_deadline; /* give up waiting for the argument after this */
+
+	/* Paired sensors and learned TX timing survive a power cycle */
+	EepromStorage eeprom;
+	WarmStart warm_start;
 
 	/***************************
 	 * Private methods
 	 ***************************/
 
-	/* Poll CC TRX (e.g. EDF IAM) with ID == id_next_cc_trx
-	 * Listen for response. */
-	void poll_next_cc_trx();
+	/* Poll CC TRX (e.g. EDF IAM) with ID == id_next_cc_trx if its
+	 * reply is due before deadline (when the next CC TX window opens).
+	 * TRXs which don't need polling are skipped whatever the deadline.
+	 * Doesn't wait for the response: process_rx_pack_buf_and_find_id()
+	 * matches it against pending_polls when it arrives. */
+	void poll_next_cc_trx(const millis_t& deadline);
+
+	/* Once the first pass of a roll call is done, retry the TRXs which
+	 * missed their poll (see CcTrxArray::add_retry()), one per call. */
+	void retry_next_cc_trx(const millis_t& deadline);
+
+	/* Poll trx unless its reply might collide with another TRX's or
+	 * wouldn't arrive before deadline.  @return true if we polled trx */
+	bool try_to_poll(CcTrx& trx, const millis_t& deadline);
+
+	/* Forget polls which have waited longer than CC_TRX_TIMEOUT */
+	void expire_pending_polls();
+
+	/* Send counters over serial, as JSON */
+	void print_stats() const;
+
+	/* Print free RAM and each sensor array's size and capacity */
+	void print_memory() const;
 
 	void wait_for_cc_tx();
 
 	/* @return true if we get a response from id before wait_duration is up */
 	bool wait_for_response(const id_t& id, const millis_t& wait_duration);
 
+	/**
+	 * Process whatever serial bytes have arrived.  Never blocks: commands
+	 * which take an argument are only run once their argument line is
+	 * complete, which may be many calls to run() later.
+	 */
 	void handle_serial_commands();
 
+	/* Handle the first character of a command */
+	void handle_serial_cmd(const char& cmd);
+
+	/* Make cmd the pending_cmd and start parsing its argument */
+	void wait_for_serial_arg(const char& cmd);
+
+	/* Run pending_cmd now that its argument has arrived */
+	void handle_serial_cmd_arg(const char& cmd, const uint32_t& arg);
+
 	/**
-	 * Process every packet in rx_packet_buffer appropriately
+	 * Process every done packet in rx_packet_buffer appropriately,
+	 * oldest first (see RxPacketFromSensor::ready_packets)
 	 *
 	 * @return true if a packet corresponding to id is found
 	 */
@@ -94,12 +213,76 @@ private:
 
 	void handle_pair_request(const RxPacketFromSensor& packet);
 
+	/**
+	 * Send packet's reading over serial in the current output_format.
+	 */
+	void print_reading(const RxPacketFromSensor& packet,
+	        const bool reply_to_poll = false);
+
+	/**
+	 * Start printing the readings of every TRX which replied since the
+	 * last batch as one JSON object.  The readings are written by
+	 * continue_trx_batch(), as serial_tx has room for them.  If another
+	 * record has to be printed meanwhile then split_trx_batch() closes
+	 * the object and the rest of the batch follows in another.
+	 */
+	void start_trx_batch();
+
+	/* Write as many readings of the open batch as serial_tx has room
+	 * for or, if wait, finish the batch whether or not there's room. */
+	void continue_trx_batch(const bool wait = false);
+
+	/* Close the current batch frame so another record can follow it */
+	void split_trx_batch();
+
+	void print_trx_batch_header();
+
+	/* Close the current batch frame and send everything waiting in
+	 * serial_tx, without waiting for the rest of the batch.
+	 * Call before writing to Serial directly. */
+	void flush_serial_tx();
+
+	/**
+	 * (Re)start aggregating over windows of window seconds, forgetting
+	 * any readings aggregated so far.  0 stops aggregating.
+	 * window is passed by value because it may be aggregate_window.
+	 * @return false if we're out of memory (aggregation is then off)
+	 */
+	bool start_aggregating(const uint16_t window);
+
+	/**
+	 * If aggregating, add packet's reading to the aggregates of
+	 * cc_txs[index] (if packet is from a TX) or cc_trxs[index].
+	 * @return false if not aggregating, so packet should be printed
+	 */
+	bool aggregate_reading(const RxPacketFromSensor& packet, const index_t& index);
+
+	/**
+	 * Report-on-change.  Allocates last_reports the first time it's
+	 * needed and again after TRXs have been added or removed, so each
+	 * TRX's next reading is reported.
+	 * @return true if the reading in packet from cc_trxs[index] should
+	 *         be printed
+	 */
+	bool report_due(const RxPacketFromSensor& packet, const index_t& index);
+
+	/* Free last_reports */
+	void forget_last_reports();
+
+	/* Once the window has ended, start printing the aggregates */
+	void end_aggregate_window();
+
+	/* Print as many aggregates from the last window as serial_tx has
+	 * room for or, if wait, all of them whether or not there's room.
+	 * Resets each aggregate once it's printed. */
+	void print_aggregates(const bool wait = false);
+
 	/**
 	 * If pair_with != ID_INVALID then pair with pair_with.
 	 */
 	void pair(const RxPacketFromSensor& packet);
 
-	void change_state(const bool state);
+	void change_state(const bool state, const id_t& id_to_switch);
 
     /**
      * Poll a CurrentCost transceiver (TRX), e.g. an EDF Wireless Transmitter Plug,
@@ -0,0 +1,79 @@
+/*
+ * PendingPolls.cpp
+ *
+ *      Author: Jack Kelly
+ */
+
+#include "PendingPolls.h"
+
+PendingPolls::PendingPolls(): n(0) {}
+
+
+bool PendingPolls::add(const id_t& id, const millis_t& sent_at, const uint8_t& timeout)
+{
+    if (full() || contains(id)) {
+        return false;
+    }
+
+    polls[n].id = id;
+    polls[n].sent_at = sent_at;
+    polls[n].timeout = timeout;
+    n++;
+    return true;
+}
+
+
+bool PendingPolls::contains(const id_t& id) const
+{
+    for (uint8_t j=0; j<n; j++) {
+        if (polls[j].id == id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool PendingPolls::awaiting_reply(const millis_t& now) const
+{
+    for (uint8_t j=0; j<n; j++) {
+        if (now - polls[j].sent_at < polls[j].timeout) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool PendingPolls::remove(const id_t& id, millis_t& sent_at)
+{
+    for (uint8_t j=0; j<n; j++) {
+        if (polls[j].id == id) {
+            sent_at = polls[j].sent_at;
+            remove_index(j);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool PendingPolls::expire(const millis_t& now, const millis_t& timeout, id_t& id)
+{
+    for (uint8_t j=0; j<n; j++) {
+        if (now - polls[j].sent_at >= timeout) { // copes with millis() roll-over
+            id = polls[j].id;
+            remove_index(j);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void PendingPolls::remove_index(const uint8_t& index)
+{
+    /* Order doesn't matter so just move the last poll into the gap */
+    n--;
+    polls[index] = polls[n];
+}
@@ -0,0 +1,81 @@
+/*
+ * PendingPolls.h
+ *
+ *      Author: Jack Kelly
+ *
+ * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
+ * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
+ * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE
+ * QUALITY AND PERFORMANCE OF THE PROGRAM IS WITH YOU. SHOULD THE PROGRAM PROVE
+ * DEFECTIVE, YOU ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ */
+
+#ifndef PENDINGPOLLS_H_
+#define PENDINGPOLLS_H_
+
+#include "consts.h"
+
+/**
+ * Table of TRX polls which have been sent but not yet answered,
+ * keyed by TRX ID.  Lets Manager send the next poll without waiting
+ * for the reply to the previous one.
+ *
+ * The table is tiny (MAX_PENDING_POLLS) so a linear search is fine.
+ */
+class PendingPolls {
+public:
+    PendingPolls();
+
+    bool full() const { return n == MAX_PENDING_POLLS; }
+    bool empty() const { return n == 0; }
+    const uint8_t& get_n() const { return n; }
+
+    /**
+     * @param timeout how long id normally takes to reply (see CcTrx::get_timeout())
+     * @return false if the table is full or id is already pending
+     */
+    bool add(const id_t& id, const millis_t& sent_at, const uint8_t& timeout);
+
+    /**
+     * @return true if any pending poll is younger than its timeout,
+     *         i.e. its reply could be on the air now or very soon
+     */
+    bool awaiting_reply(const millis_t& now) const;
+
+    bool contains(const id_t& id) const;
+
+    /**
+     * Remove id from the table.
+     *
+     * @param sent_at set to the time the poll was sent if id was pending
+     * @return true if id was pending
+     */
+    bool remove(const id_t& id, millis_t& sent_at);
+
+    /**
+     * Remove one poll which has been pending for longer than timeout.
+     * Call repeatedly until it returns false to expire every stale poll.
+     *
+     * @param id set to the ID of the expired poll
+     * @return true if a poll was expired
+     */
+    bool expire(const millis_t& now, const millis_t& timeout, id_t& id);
+
+    void clear() { n = 0; }
+
+private:
+    void remove_index(const uint8_t& index);
+
+    struct Poll {
+        id_t id;
+        millis_t sent_at;
+        uint8_t timeout;
+    };
+
+    Poll polls[MAX_PENDING_POLLS];
+    uint8_t n;
+};
+
+#endif /* PENDINGPOLLS_H_ */
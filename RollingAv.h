@@ -24,21 +24,113 @@
 
 #include "consts.h"
 
+enum RollingAvMode {
+    ROLLING_MEAN,         /* mean of the window. O(1) per sample */
+    ROLLING_MEDIAN,       /* median of the window. O(WINDOW) per sample */
+    ROLLING_TRIMMED_MEAN  /* mean without the smallest and largest sample. O(WINDOW) */
+};
+
+/* Largest value of an integer type, signed or unsigned, at compile time */
+template <class T>
+struct IntMax {
+    static const T value = (T)~(T)0 > 0 ? (T)~(T)0 : (T)(~(T)0 ^ ((T)1 << (sizeof(T)*8 - 1)));
+};
+
+
 /**
- * Class for keeping a rolling average
+ * Average of the last WINDOW samples.
+ *
+ * Keeps a running sum in an acc_t, so adding a sample is O(1) in
+ * ROLLING_MEAN mode.  The median and trimmed-mean modes also keep a
+ * sorted copy of the window so that a few wild samples don't drag the
+ * average away; use them instead of range-checking samples.
+ *
+ * acc_t must be able to hold WINDOW * the largest sample_t; this is
+ * checked at compile time.
  */
-class RollingAv {
+template <uint8_t WINDOW = 5, class sample_t = uint16_t, class acc_t = uint32_t,
+          RollingAvMode MODE = ROLLING_MEAN>
+class RollingAverage {
 public:
-    RollingAv();
-    void add_sample(const uint16_t& sample);
-    const uint16_t& get_av();
+    /* The window starts full of initial samples */
+    RollingAverage(const sample_t& initial = SAMPLE_PERIOD)
+    : index(0), sum((acc_t)initial * WINDOW), av(initial)
+    {
+        for (uint8_t j=0; j<WINDOW; j++) {
+            samples[j] = initial;
+        }
+        if (MODE != ROLLING_MEAN) {
+            for (uint8_t j=0; j<WINDOW; j++) {
+                sorted[j] = initial;
+            }
+        }
+    }
+
+
+    void add_sample(const sample_t& sample)
+    {
+        const sample_t oldest = samples[index];
+        samples[index] = sample;
+        if (++index == WINDOW) {
+            index = 0;
+        }
+        sum = sum - oldest + sample;
+
+        switch (MODE) {
+        case ROLLING_MEAN:
+            av = sum / (acc_t)WINDOW;
+            break;
+        case ROLLING_MEDIAN:
+            replace_sorted(oldest, sample);
+            av = (WINDOW % 2) ? sorted[WINDOW/2] :
+                    ((acc_t)sorted[WINDOW/2 - 1] + sorted[WINDOW/2]) / 2;
+            break;
+        case ROLLING_TRIMMED_MEAN:
+            replace_sorted(oldest, sample);
+            av = (sum - sorted[0] - sorted[WINDOW-1]) / (acc_t)(WINDOW - 2);
+            break;
+        }
+    }
+
+
+    const sample_t& get_av() const { return av; }
 
 private:
-    static const index_t NUM_SAMPLES = 5;
-    uint16_t samples[NUM_SAMPLES];
-    index_t index;
-    uint16_t av_cache;
-    bool cache_valid;
+    /* Compile-time checks (C++03 doesn't have static_assert) */
+    typedef char window_must_not_be_empty[WINDOW > 0 ? 1 : -1];
+    typedef char trimmed_mean_needs_three_samples[
+        MODE != ROLLING_TRIMMED_MEAN || WINDOW >= 3 ? 1 : -1];
+    typedef char accumulator_too_small_for_window[
+        IntMax<acc_t>::value / WINDOW >= IntMax<sample_t>::value ? 1 : -1];
+
+    /* Remove oldest from sorted and insert sample, keeping sorted in order */
+    void replace_sorted(const sample_t& oldest, const sample_t& sample)
+    {
+        uint8_t j = 0;
+        while (sorted[j] != oldest) { // oldest must be in sorted
+            j++;
+        }
+        // Shuffle towards where sample belongs, filling the gap left by oldest
+        while (j > 0 && sorted[j-1] > sample) {
+            sorted[j] = sorted[j-1];
+            j--;
+        }
+        while (j < WINDOW-1 && sorted[j+1] < sample) {
+            sorted[j] = sorted[j+1];
+            j++;
+        }
+        sorted[j] = sample;
+    }
+
+    sample_t samples[WINDOW]; /* ring buffer, oldest at samples[index] */
+    sample_t sorted[MODE == ROLLING_MEAN ? 1 : WINDOW]; /* window in ascending order */
+    uint8_t index;
+    acc_t sum;
+    sample_t av;
 };
 
+
+/* The original RollingAv: mean of the last 5 uint16_t samples */
+typedef RollingAverage<> RollingAv;
+
 #endif /* ROLLINGAV_H_ */
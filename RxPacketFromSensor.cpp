@@ -6,20 +6,78 @@
  */
 
 #include "RxPacketFromSensor.h"
+#include "SerialTx.h"
 #include <utils.h>
 
 #ifdef TESTING
 #include <tests/FakeArduino.h>
 #else
 #include <Arduino.h>
+#include <avr/pgmspace.h>
 #endif // TESTING
 
+#ifndef PROGMEM
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const byte*)(addr))
+#endif
+
+/**
+ * De-Manchesterisation lookup table, built by the preprocessor.
+ *
+ * Indexed by a raw (Manchesterised) byte.  The low nibble of each entry
+ * holds the 4 decoded bits, most significant bit pair first.  Bit 7 is set
+ * if any bit pair was illegal (00 or 11); illegal pairs decode to 0,
+ * as they always have.
+ */
+#define DM_PAIR(b, shift) (((b) >> (shift)) & 0x03)
+#define DM_BIT(b, shift)  (DM_PAIR(b, shift) == 0x02 ? 1 : 0)
+#define DM_BAD(b, shift)  ((DM_PAIR(b, shift) == 0x00 || DM_PAIR(b, shift) == 0x03) ? 0x80 : 0)
+#define DM(b) ((DM_BIT(b, 6) << 3) | (DM_BIT(b, 4) << 2) | (DM_BIT(b, 2) << 1) | DM_BIT(b, 0) | \
+               DM_BAD(b, 6) | DM_BAD(b, 4) | DM_BAD(b, 2) | DM_BAD(b, 0))
+#define DM4(b)   DM(b),       DM((b)+1),    DM((b)+2),    DM((b)+3)
+#define DM16(b)  DM4(b),      DM4((b)+4),   DM4((b)+8),   DM4((b)+12)
+#define DM64(b)  DM16(b),     DM16((b)+16), DM16((b)+32), DM16((b)+48)
+#define DM256    DM64(0),     DM64(64),     DM64(128),    DM64(192)
+
+static const byte DEMANCHESTER_TABLE[256] PROGMEM = { DM256 };
+
+static const byte DM_BAD_FLAG = 0x80;
+
+#undef DM256
+#undef DM64
+#undef DM16
+#undef DM4
+#undef DM
+#undef DM_BAD
+#undef DM_BIT
+#undef DM_PAIR
+
+const index_t RxPacketFromSensor::BINARY_RECORD_LENGTH;
+const index_t RxPacketFromSensor::BINARY_FRAME_LENGTH;
+
+SpscQueue<RxPacketFromSensor*, PACKET_BUF_LENGTH> RxPacketFromSensor::ready_packets;
+
+
 RxPacketFromSensor::RxPacketFromSensor()
-:tx_type(CCTX), id(ID_INVALID) {}
+:tx_type(CCTX), decoded(false), id(ID_INVALID) {}
 
 
 void RxPacketFromSensor::post_process()
 {
+    decoded = false;
+#ifndef LAZY_DECODE
+    decode();
+#endif
+    ready_packets.push(this);
+}
+
+
+void RxPacketFromSensor::decode()
+{
+    if (decoded || !done()) {
+        return;
+    }
+
     switch (tx_type) {
     case CCTX: health = de_manchesterise(); break;
     case CCTRX: health = verify_checksum(); break;
@@ -29,6 +87,8 @@ void RxPacketFromSensor::post_process()
         decode_wattage();
         decode_id();
     }
+
+    decoded = true;
 }
 
 
@@ -47,48 +107,104 @@ void RxPacketFromSensor::print_id_and_watts(const bool reply_to_poll) const
 {
     print_id_and_type();
 
-    Serial.print(F(", \"t\": "));
-    Serial.print(timecode);
+    serial_tx.print(F(", \"t\": "));
+    serial_tx.print(timecode);
 
     print_sensors();
 
     if (tx_type == CCTRX) {
-        Serial.print(F(", \"state\": "));
-        Serial.print(packet[10]==0x53 ? F("1") : F("0"));
-        Serial.print(F(", \"reply_to_poll\": "));
-        Serial.print(reply_to_poll ? F("1") : F("0"));
+        serial_tx.print(F(", \"state\": "));
+        serial_tx.print(packet[10]==0x53 ? F("1") : F("0"));
+        serial_tx.print(F(", \"reply_to_poll\": "));
+        serial_tx.print(reply_to_poll ? F("1") : F("0"));
+    }
+
+    serial_tx.println(F("}"));
+}
+
+
+index_t RxPacketFromSensor::encode_binary(byte* frame, const bool reply_to_poll) const
+{
+    /* Build the record (little-endian) in frame+2, leaving room for
+     * the leading delimiter and the first COBS code byte. */
+    byte* record = frame + 2;
+    index_t i = 0;
+
+    record[i++] = tx_type == CCTX ? 0x01 : 0x02;
+    for (index_t b=0; b<4; b++) record[i++] = (id >> (b*8)) & 0xFF;
+    for (index_t b=0; b<4; b++) record[i++] = (timecode >> (b*8)) & 0xFF;
+    for (index_t sensor=0; sensor<3; sensor++) {
+        record[i++] = watts[sensor] & 0xFF;
+        record[i++] = watts[sensor] >> 8;
     }
+    record[i++] = tx_type == CCTRX ? (packet[10]==0x53) : 0xFF;
+    record[i++] = reply_to_poll;
 
-    Serial.println(F("}"));
+    byte checksum = 0;
+    for (index_t j=0; j<i; j++) {
+        checksum += record[j];
+    }
+    record[i++] = checksum;
+
+    /* COBS-encode in place.  Each zero is replaced by the distance to the
+     * next zero (or to the end of the record); the first code byte goes
+     * in frame[1].  Records are < 254 bytes so there's only ever one
+     * code byte of overhead. */
+    frame[0] = 0x00;
+    index_t code_i = 1;
+    byte code = 1;
+    for (index_t j=0; j<BINARY_RECORD_LENGTH; j++) {
+        if (record[j] == 0x00) {
+            frame[code_i] = code;
+            code_i = j + 2;
+            code = 1;
+        } else {
+            code++;
+        }
+    }
+    frame[code_i] = code;
+    frame[BINARY_FRAME_LENGTH-1] = 0x00;
+
+    return BINARY_FRAME_LENGTH;
+}
+
+
+void RxPacketFromSensor::print_binary(const bool reply_to_poll) const
+{
+    byte frame[BINARY_FRAME_LENGTH];
+    const index_t length = encode_binary(frame, reply_to_poll);
+    for (index_t i=0; i<length; i++) {
+        serial_tx.write(frame[i]);
+    }
 }
 
 
 void RxPacketFromSensor::print_id_and_type(const bool on_its_own) const
 {
-    Serial.print(F("{\"type\": \""));
-    Serial.print(tx_type == CCTX ? F("tx") : F("trx"));
-    Serial.print(F("\", \"id\": ")); // {"type": "tx", "id": 123, "t": 1000, "sensors": {0: 100, 1: 500}}
-    Serial.print(id);
-    if (on_its_own) Serial.print(F("}"));
+    serial_tx.print(F("{\"type\": \""));
+    serial_tx.print(tx_type == CCTX ? F("tx") : F("trx"));
+    serial_tx.print(F("\", \"id\": ")); // {"type": "tx", "id": 123, "t": 1000, "sensors": {0: 100, 1: 500}}
+    serial_tx.print(id);
+    if (on_its_own) serial_tx.print(F("}"));
 }
 
 
 void RxPacketFromSensor::print_sensors() const
 {
-    Serial.print(F(", \"sensors\": {"));
+    serial_tx.print(F(", \"sensors\": {"));
 
     bool first = true;
     for (index_t i=0; i<3; i++) {
         if (watts[i]!=WATTS_INVALID) {
-            if (first) first = false; else Serial.print(F(", "));
-            Serial.print(F("\""));
-            Serial.print(i+1);
-            Serial.print(F("\": "));
-            Serial.print(watts[i]);
+            if (first) first = false; else serial_tx.print(F(", "));
+            serial_tx.print(F("\""));
+            serial_tx.print(i+1);
+            serial_tx.print(F("\": "));
+            serial_tx.print(watts[i]);
         }
     }
 
-    Serial.print(F("}"));
+    serial_tx.print(F("}"));
 }
 
 
@@ -152,47 +268,26 @@ bool RxPacketFromSensor::is_pairing_request() const
 
 RxPacketFromSensor::Health RxPacketFromSensor::de_manchesterise()
 {
-    const byte ONE = 0b10000000; // 1 in Manchester-speak is 10
-    const byte ZERO = 0b01000000; // 0 in Manchester-speak is 01
-    const byte MASK = 0b11000000; // 2-bit window to select current pit pair
-
-    byte bit, // The output bit encoded by the current source bit pair
-    src_byte, // the source byte we're currently processing
-    src_byte_masked, // the source byte masked to expose only the current pit pair
-    output; // the demanchesterised byte
-    index_t src_byte_i, src_byte_offset, bit_pair;
-    bool success = true; // true unless we find an illegal bit pair (00 and 11 are illegal)
-
-    for (src_byte_i=0; src_byte_i<length; src_byte_i+=2) {
-
-        output = 0;
-
-        // Decode 2 source bytes into 1 output byte
-        for (src_byte_offset=0; src_byte_offset<2; src_byte_offset++) {
-
-            src_byte = packet[src_byte_i+src_byte_offset];
-
-            // Decode the 4 bit pairs in src_byte
-            for (bit_pair=0; bit_pair<8; bit_pair+=2) {
-                src_byte_masked = src_byte & (MASK >> bit_pair);
-                if (src_byte_masked == ONE >> bit_pair) {
-                    bit = 1;
-                } else if (src_byte_masked == ZERO >> bit_pair) {
-                    bit = 0;
-                } else {
-                    success = false;
-                    bit = 0;
-                }
-                output <<= 1; // bit-shift output 1 to the left
-                output |= bit;
-            }
-        }
-        packet[src_byte_i / 2] = output;
-    }
-
+    const Health result = de_manchesterise(packet, length);
     length /= 2;
+    return result;
+}
+
+
+RxPacketFromSensor::Health RxPacketFromSensor::de_manchesterise(
+        volatile byte* data, const index_t length)
+{
+    byte hi, lo,  // table entries for the 2 source bytes making up 1 output byte
+         bad = 0; // DM_BAD_FLAG is set if we find an illegal bit pair
+
+    for (index_t src_byte_i=0; src_byte_i<length; src_byte_i+=2) {
+        hi = pgm_read_byte(&DEMANCHESTER_TABLE[data[src_byte_i]]);
+        lo = pgm_read_byte(&DEMANCHESTER_TABLE[data[src_byte_i+1]]);
+        bad |= hi | lo;
+        data[src_byte_i / 2] = (hi << 4) | (lo & 0x0F);
+    }
 
-    return success ? OK : BAD;
+    return (bad & DM_BAD_FLAG) ? BAD : OK;
 }
 
 
@@ -10,18 +10,67 @@
 
 #include <Packet.h>
 #include "consts.h"
+#include "SpscQueue.h"
 
 class RxPacketFromSensor : public RxPacket<> {
 public:
     RxPacketFromSensor();
     void print_id_and_watts(const bool reply_to_poll = false) const;
+
+    /**
+     * Compact alternative to print_id_and_watts().  Sends one fixed-layout
+     * record, framed using Consistent Overhead Byte Stuffing (COBS) with
+     * a 0x00 delimiter at each end so that it can be picked out from
+     * any text lines around it.  See tests/BinaryDecoder.h for the layout
+     * and a host-side decoder.
+     */
+    void print_binary(const bool reply_to_poll = false) const;
+
+    /**
+     * Build the frame sent by print_binary().
+     *
+     * @param frame must have space for BINARY_FRAME_LENGTH bytes
+     * @return length of frame
+     */
+    index_t encode_binary(byte* frame, const bool reply_to_poll = false) const;
+
+    const static index_t BINARY_RECORD_LENGTH = 18;
+    /* record + 1 byte of COBS overhead + 2 delimiters */
+    const static index_t BINARY_FRAME_LENGTH  = BINARY_RECORD_LENGTH + 3;
     void print_id_and_type(const bool on_its_own = false) const;
     void print_sensors() const;
     bool is_pairing_request() const;
     const volatile TxType& get_tx_type() const;
+
+    /**
+     * If this packet is done and not yet decoded then demanchesterise
+     * (if from TX) or verify the checksum (if from TRX), and set health,
+     * watts and id.  Only ever does the work once per packet received.
+     * With LAZY_DECODE the main loop calls this once it has popped the
+     * packet from ready_packets; until then is_ok() is false.
+     */
+    void decode();
+
+    /* Only valid once decode()d and is_ok() */
     const id_t& get_id() const;
     const watts_t* get_watts() const;
 
+    /**
+     * De-Manchesterise length bytes of data in place, leaving length/2
+     * decoded bytes at the start of data.  Uses a 256-entry lookup table
+     * which decodes a whole source byte (4 bit pairs) at a time.
+     *
+     * @return OK if de-manchesterisation went OK
+     * @return BAD if any illegal bit pairs (11 or 00) were found
+     */
+    static Health de_manchesterise(volatile byte* data, const index_t length);
+
+    /* Every packet pushes itself onto here from the ISR once it's done
+     * (see post_process()).  Pop from the main loop to find done packets
+     * in the order they arrived.  A popped packet belongs to the main loop
+     * until it calls reset(), which hands it back to the ISR. */
+    static SpscQueue<RxPacketFromSensor*, PACKET_BUF_LENGTH> ready_packets;
+
 private:
     /********************
      * Consts           *
@@ -33,6 +82,7 @@ private:
      * Member variables used within ISR and outside ISR *
      ****************************************************/
     volatile TxType tx_type; // is this packet from a transmit-only sensor (as opposed to a transceiver)?
+    volatile bool decoded; // have health, watts and id been set from this packet's bytes?
 
     /******************************************
      * Member variables never used within ISR *
@@ -47,8 +97,8 @@ private:
     void handle_first_byte(const byte& first_byte);
 
     /**
-     * Run this after packet has been received fully to
-     * demanchesterise (if from TX), set health, watts and id.
+     * Run from the ISR after packet has been received fully.  Pushes
+     * it onto ready_packets; without LAZY_DECODE, decode()s it first.
      */
     void post_process();
 
@@ -0,0 +1,71 @@
+/*
+ * SensorAggregate.h
+ *
+ *      Author: Jack Kelly
+ *
+ * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
+ * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
+ * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE
+ * QUALITY AND PERFORMANCE OF THE PROGRAM IS WITH YOU. SHOULD THE PROGRAM PROVE
+ * DEFECTIVE, YOU ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ */
+
+#ifndef SENSORAGGREGATE_H_
+#define SENSORAGGREGATE_H_
+
+#ifdef TESTING
+#include <inttypes.h>
+#else
+#include <Arduino.h>
+#endif
+
+#include "consts.h"
+
+/**
+ * Min, max and mean of one sensor's readings over an aggregation window
+ * (see Manager::aggregate_reading()).  10 bytes.
+ */
+class SensorAggregate {
+public:
+    SensorAggregate() { reset(); }
+
+    void reset()
+    {
+        min = WATTS_INVALID;
+        max = 0;
+        sum = 0;
+        n = 0;
+    }
+
+    /* Readings of WATTS_INVALID (e.g. unplugged TX sensors) are ignored */
+    void add(const watts_t& watts)
+    {
+        if (watts == WATTS_INVALID || n == 0xFFFF) {
+            return;
+        }
+        if (watts < min) min = watts;
+        if (watts > max) max = watts;
+        sum += watts;
+        n++;
+    }
+
+    watts_t get_mean() const { return n ? sum / n : 0; }
+
+    /**
+     * @return energy in milliwatt-hours used over window_s seconds,
+     * assuming the sensor read get_mean() for the whole window (including
+     * any gaps between readings).  Accurate to 10 mWh.
+     */
+    uint32_t get_mwh(const uint16_t& window_s) const
+    {
+        return (uint32_t)get_mean() * window_s / 36 * 10;
+    }
+
+    watts_t min, max;
+    uint32_t sum;
+    uint16_t n;
+};
+
+#endif /* SENSORAGGREGATE_H_ */
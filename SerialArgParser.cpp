@@ -0,0 +1,46 @@
+/*
+ * SerialArgParser.cpp
+ *
+ *      Author: Jack Kelly
+ */
+
+#include "SerialArgParser.h"
+
+SerialArgParser::SerialArgParser()
+: value(0), valid(true), empty(true) {}
+
+
+void SerialArgParser::reset()
+{
+    value = 0;
+    valid = true;
+    empty = true;
+}
+
+
+bool SerialArgParser::feed(const char& c)
+{
+    if (c == '\r' || c == '\n') {
+        return true;
+    }
+
+    if (c >= '0' && c <= '9') {
+        const uint8_t digit = c - '0';
+        if (value > (UINT32_INVALID - digit) / 10) {
+            valid = false; // overflow
+        } else {
+            value = (value * 10) + digit;
+        }
+        empty = false;
+    } else {
+        valid = false;
+    }
+
+    return false;
+}
+
+
+uint32_t SerialArgParser::get_value() const
+{
+    return (valid && !empty) ? value : UINT32_INVALID;
+}
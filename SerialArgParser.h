@@ -0,0 +1,59 @@
+/*
+ * SerialArgParser.h
+ *
+ *      Author: Jack Kelly
+ *
+ * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
+ * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
+ * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE
+ * QUALITY AND PERFORMANCE OF THE PROGRAM IS WITH YOU. SHOULD THE PROGRAM PROVE
+ * DEFECTIVE, YOU ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ */
+
+#ifndef SERIALARGPARSER_H_
+#define SERIALARGPARSER_H_
+
+#ifdef TESTING
+#include <inttypes.h>
+#else
+#include <Arduino.h>
+#endif
+
+#include <utilsconsts.h>
+
+/**
+ * Incrementally parses a decimal uint32 argument typed over serial,
+ * one character at a time, so that Manager::run() never has to block
+ * waiting for the rest of the line (unlike utils::read_uint32_from_serial()).
+ *
+ * The argument ends with '\r' or '\n'.  An empty argument, any character
+ * other than a digit, or a number which doesn't fit in 32 bits makes the
+ * whole argument invalid.
+ */
+class SerialArgParser {
+public:
+    SerialArgParser();
+
+    /* Forget any partially received argument. */
+    void reset();
+
+    /**
+     * @return true once the end of the argument has been received,
+     *         in which case get_value() returns the argument.
+     */
+    bool feed(const char& c);
+
+    /**
+     * @return the argument, or UINT32_INVALID if it was invalid.
+     */
+    uint32_t get_value() const;
+
+private:
+    uint32_t value;
+    bool valid;
+    bool empty;
+};
+
+#endif /* SERIALARGPARSER_H_ */
@@ -0,0 +1,112 @@
+/*
+ * SerialTx.cpp
+ *
+ *      Author: Jack Kelly
+ */
+
+#include "SerialTx.h"
+
+#ifndef TESTING
+#include <avr/pgmspace.h>
+#endif
+
+SerialTx serial_tx;
+
+
+SerialTx::SerialTx()
+: head(0), n(0), fresh(0), num_deferred(0), num_blocked(0), high_water(0) {}
+
+
+void SerialTx::write(const char& c)
+{
+    if (n == SERIAL_TX_BUFFER_LENGTH) {
+        // Wait for the UART rather than lose output
+        send_one();
+        num_blocked++;
+        num_deferred++;
+    } else if (fresh < 0xFF) {
+        fresh++;
+    }
+
+    uint16_t tail = head + n;
+    if (tail >= SERIAL_TX_BUFFER_LENGTH) {
+        tail -= SERIAL_TX_BUFFER_LENGTH;
+    }
+    buffer[tail] = c;
+    n++;
+    if (n > high_water) high_water = n;
+}
+
+
+void SerialTx::print(const char* s)
+{
+    while (*s) {
+        write(*s++);
+    }
+}
+
+
+#ifndef TESTING
+void SerialTx::print(const __FlashStringHelper* s)
+{
+    const char* p = reinterpret_cast<const char*>(s);
+    char c;
+    while ((c = pgm_read_byte(p++))) {
+        write(c);
+    }
+}
+#endif // TESTING
+
+
+void SerialTx::print_number(uint32_t value)
+{
+    char digits[10]; // enough for 4294967295
+    uint8_t i = 0;
+    do {
+        digits[i++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    while (i) {
+        write(digits[--i]);
+    }
+}
+
+
+void SerialTx::send_one()
+{
+#ifdef TESTING
+    Serial.print(buffer[head]);
+#else
+    Serial.write((uint8_t)buffer[head]);
+#endif
+    head = head+1 == SERIAL_TX_BUFFER_LENGTH ? 0 : head+1;
+    n--;
+}
+
+
+void SerialTx::drain()
+{
+#ifdef TESTING
+    int room = SERIAL_TX_BUFFER_LENGTH; // FakeSerial never blocks
+#else
+    int room = Serial.availableForWrite();
+#endif
+    while (n && room > 0) {
+        send_one();
+        room--;
+    }
+
+    // FIFO, so whatever is still waiting includes the newest bytes
+    num_deferred += n < fresh ? n : fresh;
+    fresh = 0;
+}
+
+
+void SerialTx::flush()
+{
+    while (n) {
+        send_one();
+    }
+    fresh = 0;
+}
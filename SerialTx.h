@@ -0,0 +1,90 @@
+/*
+ * SerialTx.h
+ *
+ *      Author: Jack Kelly
+ *
+ * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
+ * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
+ * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE
+ * QUALITY AND PERFORMANCE OF THE PROGRAM IS WITH YOU. SHOULD THE PROGRAM PROVE
+ * DEFECTIVE, YOU ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ */
+
+#ifndef SERIALTX_H_
+#define SERIALTX_H_
+
+#ifdef TESTING
+#include <tests/FakeArduino.h>
+#else
+#include <Arduino.h>
+#endif
+
+#include "consts.h"
+
+/**
+ * Ring buffer in front of Serial so that printing a reading doesn't stall
+ * the main loop while the UART sends it.  Readings are formatted into the
+ * ring with print() and sent by drain(), which only writes as many bytes
+ * as the UART has room for.  Manager::run() calls drain() every time
+ * round, and keeps calling it while it waits for packets.
+ *
+ * Nothing is ever dropped: if a burst of readings fills the ring then
+ * write() waits for the UART to make room, as Serial.print() would, and
+ * counts the bytes as blocked.
+ *
+ * Anything which writes to Serial directly must flush() first, or its
+ * output could land in the middle of a reading.
+ */
+class SerialTx {
+public:
+    SerialTx();
+
+    void write(const char& c);
+    void print(const char& c) { write(c); }
+    void print(const char* s);
+#ifndef TESTING
+    void print(const __FlashStringHelper* s);
+#endif
+    template <class T> void print(const T& n) { print_number(n); } /* unsigned only */
+    void println() { write('\r'); write('\n'); }
+    template <class T> void println(const T& x) { print(x); println(); }
+
+    /* Send as much as the UART has room for without blocking. */
+    void drain();
+
+    /* Block until everything in the ring has been sent. */
+    void flush();
+
+    bool empty() const { return n == 0; }
+
+    /* @return number of bytes which can be written without waiting */
+    uint8_t get_room() const { return SERIAL_TX_BUFFER_LENGTH - n; }
+
+    /* Bytes which couldn't go straight out at the next drain(),
+     * including those which were blocked */
+    const uint32_t& get_num_deferred() const { return num_deferred; }
+
+    /* Bytes which had to wait for room in a full ring */
+    const uint32_t& get_num_blocked() const { return num_blocked; }
+
+    const uint8_t& get_high_water() const { return high_water; }
+
+private:
+    void print_number(uint32_t value);
+
+    /* Send the oldest byte, waiting for the UART if need be */
+    void send_one();
+
+    char buffer[SERIAL_TX_BUFFER_LENGTH];
+    uint8_t head, n;        /* oldest byte, and number of bytes waiting */
+
+    uint8_t fresh;          /* bytes written since the last drain(), not blocked */
+    uint32_t num_deferred, num_blocked;
+    uint8_t high_water;
+};
+
+extern SerialTx serial_tx;
+
+#endif /* SERIALTX_H_ */
@@ -0,0 +1,142 @@
+/*
+ * SpscQueue.h
+ *
+ *      Author: Jack Kelly
+ *
+ * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
+ * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
+ * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE
+ * QUALITY AND PERFORMANCE OF THE PROGRAM IS WITH YOU. SHOULD THE PROGRAM PROVE
+ * DEFECTIVE, YOU ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ */
+
+#ifndef SPSCQUEUE_H_
+#define SPSCQUEUE_H_
+
+#include "consts.h"
+
+/* Stop memory accesses being reordered across this point.  AVRs have one
+ * core so only the compiler needs restraining; on the host the producer
+ * may be another thread (see tests/SpscQueue_test.cpp). */
+#ifdef __AVR__
+#define SPSC_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+#else
+#define SPSC_BARRIER() __sync_synchronize()
+#endif
+
+/**
+ * Lock-free FIFO for handing items from an interrupt to the main loop.
+ *
+ * Single producer, single consumer: push() is only called from the ISR
+ * and pop() only from the main loop.  The producer only writes tail and
+ * the consumer only writes head, and both are single bytes, so neither
+ * side needs to disable interrupts.  An item belongs to the producer
+ * until push() publishes it by moving tail, and to the consumer from
+ * the moment pop() returns it.
+ *
+ * The producer also keeps counters.  They can be read from the main loop
+ * at any time.
+ */
+template <class item_t, uint8_t LENGTH>
+class SpscQueue {
+public:
+    SpscQueue()
+    : head(0), tail(0), num_enqueued(0), num_dropped(0), num_full(0),
+      high_water(0) {}
+
+    /**
+     * Producer only.
+     *
+     * @return false (and count a drop) if the queue is full
+     */
+    bool push(const item_t& item)
+    {
+        const uint8_t t = tail;
+        const uint8_t next_tail = t+1 == SLOTS ? 0 : t+1;
+        if (next_tail == head) {
+            num_dropped++;
+            return false;
+        }
+
+        slots[t] = item;
+        SPSC_BARRIER(); // write the item before publishing it
+        tail = next_tail;
+
+        num_enqueued++;
+        const uint8_t n = size();
+        if (n > high_water) {
+            high_water = n;
+        }
+        if (n == LENGTH) {
+            num_full++;
+        }
+        return true;
+    }
+
+    /**
+     * Consumer only.
+     *
+     * @param item set to the oldest item, if any
+     * @return false if the queue is empty
+     */
+    bool pop(item_t& item)
+    {
+        const uint8_t h = head;
+        if (h == tail) {
+            return false;
+        }
+
+        SPSC_BARRIER(); // read tail before the item it published
+        item = slots[h];
+        SPSC_BARRIER(); // finish reading the item before handing its slot back
+        head = h+1 == SLOTS ? 0 : h+1;
+        return true;
+    }
+
+    bool empty() const { return head == tail; }
+
+    uint8_t size() const
+    {
+        const uint8_t h = head, t = tail;
+        return t >= h ? t - h : t + SLOTS - h;
+    }
+
+    /* Number of items pushed */
+    uint32_t get_num_enqueued() const { return read(num_enqueued); }
+
+    /* Number of items which didn't fit */
+    uint16_t get_num_dropped() const { return read(num_dropped); }
+
+    /* Number of times push() has filled the queue */
+    uint16_t get_num_full() const { return read(num_full); }
+
+    /* Most items ever waiting at once */
+    uint8_t get_high_water() const { return high_water; }
+
+private:
+    static const uint8_t SLOTS = LENGTH + 1; /* one slot is always free so that full != empty */
+
+    /* Multi-byte reads aren't atomic on AVR, so if the ISR might have
+     * changed counter half way through, read it again. */
+    template <class counter_t>
+    static counter_t read(const volatile counter_t& counter)
+    {
+        counter_t value;
+        do {
+            value = counter;
+        } while (value != counter);
+        return value;
+    }
+
+    item_t slots[SLOTS];
+    volatile uint8_t head, tail;
+
+    /* Only written by the producer */
+    volatile uint32_t num_enqueued;
+    volatile uint16_t num_dropped, num_full;
+    volatile uint8_t  high_water;
+};
+
+#endif /* SPSCQUEUE_H_ */
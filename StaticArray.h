@@ -0,0 +1,73 @@
+/*
+ * StaticArray.h
+ *
+ *      Author: Jack Kelly
+ *
+ * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
+ * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
+ * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE
+ * QUALITY AND PERFORMANCE OF THE PROGRAM IS WITH YOU. SHOULD THE PROGRAM PROVE
+ * DEFECTIVE, YOU ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ */
+
+#ifndef STATICARRAY_H_
+#define STATICARRAY_H_
+
+#include "DynamicArray.h"
+
+/**
+ * A DynamicArray whose N items live inside the object instead of on the
+ * heap, so it never calls new and can't fragment the heap.  Its size is
+ * part of the size of whatever contains it, so it's counted by the
+ * compile-time RAM check in rfm_edf_ecomanager.cpp.
+ *
+ * Same interface as DynamicArray.  set_size() succeeds for any size up to
+ * N but doesn't change anything; append() fails once N items are stored.
+ */
+template <class item_t, index_t N, class id_index_t = NoIdIndex>
+class StaticArray : public DynamicArray<item_t, FixedCapacity, id_index_t> {
+    typedef DynamicArray<item_t, FixedCapacity, id_index_t> Base;
+public:
+    StaticArray()
+    {
+        this->data = buffer;
+        this->size = N;
+    }
+
+
+    StaticArray(const StaticArray& src)
+    : Base()
+    {
+        this->data = buffer;
+        this->size = N;
+        copy_from(src);
+    }
+
+
+    StaticArray& operator=(const StaticArray& src)
+    {
+        if (this != &src) {
+            copy_from(src);
+        }
+        return *this;
+    }
+
+private:
+    void copy_from(const StaticArray& src)
+    {
+        this->i      = src.i;
+        this->n      = src.n;
+        this->min_id = src.min_id;
+        this->max_id = src.max_id;
+        this->id_index = src.id_index;
+        for (index_t j=0; j<src.n; j++) {
+            buffer[j] = src.buffer[j];
+        }
+    }
+
+    item_t buffer[N];
+};
+
+#endif /* STATICARRAY_H_ */
@@ -0,0 +1,105 @@
+/*
+ * Storage.h
+ *
+ *      Author: Jack Kelly
+ *
+ * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
+ * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
+ * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE
+ * QUALITY AND PERFORMANCE OF THE PROGRAM IS WITH YOU. SHOULD THE PROGRAM PROVE
+ * DEFECTIVE, YOU ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ */
+
+#ifndef STORAGE_H_
+#define STORAGE_H_
+
+#ifdef TESTING
+#include <inttypes.h>
+#else
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#endif
+
+/**
+ * Byte-addressed non-volatile storage, for WarmStart.  Every cell can
+ * only be written so many times (100,000 for the ATmega328's EEPROM) so
+ * update() must not write a cell which already holds value.
+ */
+class Storage {
+public:
+    virtual ~Storage() {}
+
+    /* @return number of bytes */
+    virtual uint16_t get_size() const = 0;
+
+    virtual uint8_t read(const uint16_t& addr) const = 0;
+
+    /* Write value to addr unless addr already holds it.
+     * @return true if the cell was written */
+    virtual bool update(const uint16_t& addr, const uint8_t& value) = 0;
+
+    /* @return false if update() would have to wait for a write to finish */
+    virtual bool is_ready() const { return true; }
+};
+
+
+#ifndef TESTING
+/* The AVR's internal EEPROM */
+class EepromStorage : public Storage {
+public:
+    uint16_t get_size() const { return E2END + 1; }
+
+    uint8_t read(const uint16_t& addr) const
+    {
+        return eeprom_read_byte((const uint8_t*)(uintptr_t)addr);
+    }
+
+    bool update(const uint16_t& addr, const uint8_t& value)
+    {
+        if (read(addr) == value) {
+            return false;
+        }
+        eeprom_write_byte((uint8_t*)(uintptr_t)addr, value);
+        return true;
+    }
+
+    bool is_ready() const { return eeprom_is_ready(); }
+};
+#endif // TESTING
+
+
+/**
+ * Fake for host tests: SIZE bytes of RAM, starting out erased (0xFF)
+ * like a new EEPROM.  Counts writes so tests can check for wear.
+ */
+template <uint16_t SIZE>
+class RamStorage : public Storage {
+public:
+    RamStorage(): num_writes(0)
+    {
+        for (uint16_t j=0; j<SIZE; j++) {
+            bytes[j] = 0xFF;
+        }
+    }
+
+    uint16_t get_size() const { return SIZE; }
+
+    uint8_t read(const uint16_t& addr) const { return bytes[addr]; }
+
+    bool update(const uint16_t& addr, const uint8_t& value)
+    {
+        if (bytes[addr] == value) {
+            return false;
+        }
+        bytes[addr] = value;
+        num_writes++;
+        return true;
+    }
+
+    uint8_t bytes[SIZE]; /* Deliberately public so tests can corrupt it */
+    uint32_t num_writes;
+};
+
+#endif /* STORAGE_H_ */
@@ -0,0 +1,260 @@
+/*
+ * WarmStart.cpp
+ *
+ *      Author: Jack Kelly
+ *
+ * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
+ * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
+ * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE
+ * QUALITY AND PERFORMANCE OF THE PROGRAM IS WITH YOU. SHOULD THE PROGRAM PROVE
+ * DEFECTIVE, YOU ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ */
+
+#include "WarmStart.h"
+#include <Logger.h>
+
+const uint8_t WARM_START_MAGIC   = 0xE5;
+const uint8_t WARM_START_VERSION = 1;
+
+const uint8_t HEADER_LENGTH     = 6;
+const uint8_t COUNTS_LENGTH     = 4; /* num TXs, num TRXs */
+const uint8_t TX_RECORD_LENGTH  = 8; /* id, period_x256, ETA error SD */
+const uint8_t TRX_RECORD_LENGTH = 4; /* id */
+
+/* IDs are appended this many at a time (see restore()) */
+const uint8_t RESTORE_CHUNK = 16;
+
+WarmStart::WarmStart(Storage& _storage)
+: storage(_storage), dirty(false), saving(false), save_deadline(0),
+  next_timing_save(WARM_START_TIMING_INTERVAL), cursor(0), payload_length(0),
+  save_n_tx(0), save_n_trx(0), sum1(0), sum2(0), num_saves(0),
+  num_bytes_written(0) {}
+
+
+uint32_t WarmStart::get_image_size(const CcTxArray& cc_txs, const CcTrxArray& cc_trxs)
+{
+    return HEADER_LENGTH + COUNTS_LENGTH +
+            (uint32_t)cc_txs.get_n() * TX_RECORD_LENGTH +
+            (uint32_t)cc_trxs.get_n() * TRX_RECORD_LENGTH;
+}
+
+
+uint16_t WarmStart::read_uint16(const uint16_t& addr) const
+{
+    return storage.read(addr) | ((uint16_t)storage.read(addr+1) << 8);
+}
+
+
+uint32_t WarmStart::read_uint32(const uint16_t& addr) const
+{
+    return read_uint16(addr) | ((uint32_t)read_uint16(addr+2) << 16);
+}
+
+
+bool WarmStart::restore(CcTxArray& cc_txs, CcTrxArray& cc_trxs, const millis_t& now)
+{
+    next_timing_save = now + WARM_START_TIMING_INTERVAL;
+
+    /* Check the header, the checksum and that the counts add up */
+    if (storage.read(0) != WARM_START_MAGIC || storage.read(1) != WARM_START_VERSION) {
+        log(INFO, PSTR("No warm start image"));
+        return false;
+    }
+
+    const uint16_t length = read_uint16(2);
+    if (length < COUNTS_LENGTH || length > storage.get_size() - HEADER_LENGTH) {
+        log(WARN, PSTR("Warm start image bad length"));
+        return false;
+    }
+
+    uint8_t s1 = 0, s2 = 0;
+    for (uint16_t k=0; k<length; k++) {
+        s1 = ((uint16_t)s1 + storage.read(HEADER_LENGTH + k)) % 255;
+        s2 = ((uint16_t)s2 + s1) % 255;
+    }
+    if (read_uint16(4) != (((uint16_t)s2 << 8) | s1)) {
+        log(WARN, PSTR("Warm start image bad checksum"));
+        return false;
+    }
+
+    const index_t n_tx  = read_uint16(HEADER_LENGTH);
+    const index_t n_trx = read_uint16(HEADER_LENGTH + 2);
+    if ((uint32_t)COUNTS_LENGTH + (uint32_t)n_tx * TX_RECORD_LENGTH +
+            (uint32_t)n_trx * TRX_RECORD_LENGTH != length) {
+        log(WARN, PSTR("Warm start image bad counts"));
+        return false;
+    }
+
+    /* Allocate once, then append the (sorted) IDs a chunk at a time
+     * so each chunk is a single merge pass (see DynamicArray::append()) */
+    if ((n_tx  && !cc_txs.set_size(cc_txs.get_n() + n_tx)) ||
+        (n_trx && !cc_trxs.set_size(cc_trxs.get_n() + n_trx))) {
+        return false; // out of memory
+    }
+
+    id_t ids[RESTORE_CHUNK];
+    uint16_t addr = HEADER_LENGTH + COUNTS_LENGTH;
+    for (index_t k=0; k<n_tx; ) {
+        uint8_t j = 0;
+        for (; j<RESTORE_CHUNK && k<n_tx; j++, k++) {
+            ids[j] = read_uint32(addr + (uint16_t)k * TX_RECORD_LENGTH);
+        }
+        cc_txs.append(ids, j);
+    }
+
+    /* Learned timing.  Look each TX up in case some were already there. */
+    for (index_t k=0; k<n_tx; k++, addr+=TX_RECORD_LENGTH) {
+        index_t index;
+        if (cc_txs.find(read_uint32(addr), index)) {
+            const uint32_t period_x256 = read_uint16(addr+4) | ((uint32_t)storage.read(addr+6) << 16);
+            cc_txs[index].restore_timing(period_x256, storage.read(addr+7));
+        }
+    }
+
+    for (index_t k=0; k<n_trx; ) {
+        uint8_t j = 0;
+        for (; j<RESTORE_CHUNK && k<n_trx; j++, k++) {
+            ids[j] = read_uint32(addr + (uint16_t)k * TRX_RECORD_LENGTH);
+        }
+        cc_trxs.append(ids, j);
+    }
+
+    log(INFO, PSTR("Warm start: %u TXs, %u TRXs"), n_tx, n_trx);
+    return true;
+}
+
+
+void WarmStart::ids_changed(const millis_t& now)
+{
+    dirty = true;
+    saving = false; // start again once the IDs have settled
+    save_deadline = now + WARM_START_SAVE_DELAY;
+}
+
+
+void WarmStart::run(const CcTxArray& cc_txs, const CcTrxArray& cc_trxs, const millis_t& now)
+{
+    if (saving) {
+        if (cc_txs.get_n() != save_n_tx || cc_trxs.get_n() != save_n_trx) {
+            ids_changed(now); // someone forgot to tell us
+        } else if (continue_save(cc_txs, cc_trxs, WARM_START_BYTES_PER_RUN)) {
+            saving = false;
+        }
+        return;
+    }
+
+    if ((dirty && (int32_t)(now - save_deadline) >= 0) ||
+        (int32_t)(now - next_timing_save) >= 0) {
+        dirty = false;
+        next_timing_save = now + WARM_START_TIMING_INTERVAL;
+        if (get_image_size(cc_txs, cc_trxs) > storage.get_size()) {
+            log(WARN, PSTR("Too many sensors for warm start"));
+            return;
+        }
+        start_save(cc_txs, cc_trxs);
+        saving = true;
+    }
+}
+
+
+bool WarmStart::save(const CcTxArray& cc_txs, const CcTrxArray& cc_trxs)
+{
+    if (get_image_size(cc_txs, cc_trxs) > storage.get_size()) {
+        log(WARN, PSTR("Too many sensors for warm start"));
+        return false;
+    }
+
+    dirty = saving = false;
+    start_save(cc_txs, cc_trxs);
+    while (!continue_save(cc_txs, cc_trxs, 0xFF))
+        ;
+    return true;
+}
+
+
+void WarmStart::start_save(const CcTxArray& cc_txs, const CcTrxArray& cc_trxs)
+{
+    cursor = 0;
+    sum1 = sum2 = 0;
+    save_n_tx = cc_txs.get_n();
+    save_n_trx = cc_trxs.get_n();
+    payload_length = get_image_size(cc_txs, cc_trxs) - HEADER_LENGTH;
+}
+
+
+bool WarmStart::continue_save(const CcTxArray& cc_txs, const CcTrxArray& cc_trxs,
+        const uint8_t& max_bytes)
+{
+    for (uint8_t j=0; j<max_bytes; j++) {
+        if (!storage.is_ready()) {
+            return false; // carry on next time
+        }
+
+        uint16_t addr;
+        uint8_t value;
+        if (cursor < payload_length) {
+            addr = HEADER_LENGTH + cursor;
+            value = payload_byte(cc_txs, cc_trxs, cursor);
+            sum1 = ((uint16_t)sum1 + value) % 255;
+            sum2 = ((uint16_t)sum2 + sum1) % 255;
+        } else {
+            /* Payload's done.  Header last, so it's only valid once
+             * the payload is complete. */
+            addr = cursor - payload_length;
+            switch (addr) {
+            case 0: value = WARM_START_MAGIC; break;
+            case 1: value = WARM_START_VERSION; break;
+            case 2: value = payload_length & 0xFF; break;
+            case 3: value = payload_length >> 8; break;
+            case 4: value = sum1; break;
+            default: value = sum2; break;
+            }
+        }
+
+        if (storage.update(addr, value)) {
+            num_bytes_written++;
+        }
+
+        if (++cursor == payload_length + HEADER_LENGTH) {
+            num_saves++;
+            log(DEBUG, PSTR("Warm start image saved"));
+            return true;
+        }
+    }
+    return false;
+}
+
+
+uint8_t WarmStart::payload_byte(const CcTxArray& cc_txs, const CcTrxArray& cc_trxs,
+        const uint16_t& k)
+{
+    if (k < COUNTS_LENGTH) {
+        const index_t n = k < 2 ? cc_txs.get_n() : cc_trxs.get_n();
+        return k & 1 ? n >> 8 : n & 0xFF;
+    }
+
+    uint16_t offset = k - COUNTS_LENGTH;
+    uint32_t field;
+    uint8_t shift;
+    const uint16_t txs_length = cc_txs.get_n() * TX_RECORD_LENGTH;
+    if (offset < txs_length) {
+        const CcTx& tx = cc_txs[offset / TX_RECORD_LENGTH];
+        offset %= TX_RECORD_LENGTH;
+        if (offset < 4) {
+            field = tx.id;
+            shift = offset * 8;
+        } else if (offset < 7) {
+            field = tx.get_period_x256();
+            shift = (offset - 4) * 8;
+        } else {
+            return tx.get_eta_error_sd();
+        }
+    } else {
+        offset -= txs_length;
+        field = cc_trxs[offset / TRX_RECORD_LENGTH].id;
+        shift = (offset % TRX_RECORD_LENGTH) * 8;
+    }
+    return field >> shift;
+}
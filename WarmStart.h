@@ -0,0 +1,107 @@
+/*
+ * WarmStart.h
+ *
+ *      Author: Jack Kelly
+ *
+ * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
+ * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
+ * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE
+ * QUALITY AND PERFORMANCE OF THE PROGRAM IS WITH YOU. SHOULD THE PROGRAM PROVE
+ * DEFECTIVE, YOU ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ */
+
+#ifndef WARMSTART_H_
+#define WARMSTART_H_
+
+#include "consts.h"
+#include "Storage.h"
+#include "CcTx.h"
+
+/**
+ * Keeps the paired CC TX and TRX IDs, and each TX's learned period and
+ * ETA error, in Storage (the EEPROM) so that after a power cycle
+ * Manager::init() can restore() them instead of the host having to send
+ * every ID again.  The phase of each TX can't be restored (millis()
+ * starts again from 0) so it's learned from the TX's next packet, but
+ * from then on its window is as narrow as it was before the restart.
+ *
+ * Image (little-endian):
+ *   0  magic (WARM_START_MAGIC), version (WARM_START_VERSION)
+ *   2  payload length (uint16)
+ *   4  Fletcher-16 checksum of the payload
+ *   6  payload: num TXs (uint16), num TRXs (uint16), then for each TX
+ *      its id (uint32), period_x256 (uint24) and ETA error SD (uint8),
+ *      then each TRX's id (uint32).  In ID order, as in the arrays.
+ *
+ * Writes are coalesced: run() only saves WARM_START_SAVE_DELAY after the
+ * last call to ids_changed(), or every WARM_START_TIMING_INTERVAL, and
+ * only writes bytes which have changed.  A save is spread over many
+ * calls to run() (an EEPROM write takes 3.3 ms) and writes the header
+ * last, so an image interrupted by a power cut fails its checksum and
+ * we start cold.
+ */
+class WarmStart {
+public:
+    WarmStart(Storage& _storage);
+
+    /**
+     * Append the saved sensors to (empty) cc_txs and cc_trxs.
+     * @return false if there's no valid image, in which case the arrays
+     *         are unchanged
+     */
+    bool restore(CcTxArray& cc_txs, CcTrxArray& cc_trxs, const millis_t& now);
+
+    /* Sensors have been added or removed: save them soon */
+    void ids_changed(const millis_t& now);
+
+    /* Call every time round Manager::run().  Carries on with any save in
+     * progress, or starts one if it's due. */
+    void run(const CcTxArray& cc_txs, const CcTrxArray& cc_trxs, const millis_t& now);
+
+    /**
+     * Save everything now, waiting for the storage if need be.
+     * @return false if the image doesn't fit
+     */
+    bool save(const CcTxArray& cc_txs, const CcTrxArray& cc_trxs);
+
+    /* @return bytes the image of cc_txs and cc_trxs takes, including header */
+    static uint32_t get_image_size(const CcTxArray& cc_txs, const CcTrxArray& cc_trxs);
+
+    const uint16_t& get_num_saves() const { return num_saves; }
+    const uint32_t& get_num_bytes_written() const { return num_bytes_written; }
+
+private:
+    /* Compare (and write if need be) up to max_bytes bytes of the image.
+     * @return true once the image is complete */
+    bool continue_save(const CcTxArray& cc_txs, const CcTrxArray& cc_trxs,
+            const uint8_t& max_bytes);
+
+    void start_save(const CcTxArray& cc_txs, const CcTrxArray& cc_trxs);
+
+    /* @return byte k of the payload */
+    static uint8_t payload_byte(const CcTxArray& cc_txs, const CcTrxArray& cc_trxs,
+            const uint16_t& k);
+
+    uint16_t read_uint16(const uint16_t& addr) const;
+    uint32_t read_uint32(const uint16_t& addr) const;
+
+    Storage& storage;
+
+    bool dirty;              /* IDs have changed since the last save */
+    bool saving;             /* a save is in progress */
+    millis_t save_deadline;  /* save IDs once we reach this */
+    millis_t next_timing_save;
+
+    /* State of the save in progress */
+    uint16_t cursor;         /* bytes done: payload first, then header */
+    uint16_t payload_length;
+    index_t  save_n_tx, save_n_trx; /* array sizes when this save started */
+    uint8_t  sum1, sum2;     /* Fletcher-16 */
+
+    uint16_t num_saves;
+    uint32_t num_bytes_written;
+};
+
+#endif /* WARMSTART_H_ */
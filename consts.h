@@ -34,14 +34,123 @@ const millis_t SAMPLE_PERIOD  = 6000; /* milliseconds    */
 
 enum TxType {CCTRX, CCTX};
 
-/* length of time we're willing to wait
+/* Max length of time we're willing to wait
  * for a CC TX.  We'll open the window
  * half of WINDOW before the next CC TX's ETA. */
 const uint16_t CC_TX_WINDOW = 500;
 const uint16_t CC_TX_WINDOW_OPEN = CC_TX_WINDOW / 2;
 
-const uint8_t CC_TRX_TIMEOUT = 100; /* milliseconds to wait for reply from TRX */
-const uint8_t MAX_RETRIES = 5; /* Max num times we'll try to poll a TRX per roll call */
-const uint8_t INTER_TRX_DELAY = 10; /* (ms) Wait so we don't completely saturate the airwaves. */
+/* Each CC TX's window is sized from the spread of its arrival errors
+ * (see CcTx::get_window_open()): open CC_TX_WINDOW_SIGMAS standard
+ * deviations plus CC_TX_WINDOW_MARGIN before the ETA and close as long
+ * after.  The window doubles for each period missed in a row and is
+ * clamped to [CC_TX_WINDOW_OPEN_MIN, CC_TX_WINDOW_OPEN]. */
+const uint8_t CC_TX_WINDOW_SIGMAS = 3;
+const uint8_t CC_TX_WINDOW_MARGIN = 10;   /* ms */
+const uint8_t CC_TX_WINDOW_OPEN_MIN = 20; /* ms */
+
+/* Each CC TX's arrival phase and period are tracked by an alpha-beta
+ * filter (see CcTx::update()).  Prediction errors are multiplied by
+ * 1 / 2^shift before being added to the phase and period estimates. */
+const uint8_t CC_TX_PHASE_GAIN_SHIFT = 1;  /* alpha = 1/2 */
+const uint8_t CC_TX_PERIOD_GAIN_SHIFT = 3; /* beta = 1/8 */
+
+/* Max num CC TXs which CcTxArray keeps in its ETA heap.  Costs
+ * 2 * sizeof(index_t) bytes each.  Beyond this, next() scans every TX. */
+const index_t CC_TX_HEAP_LENGTH = 32;
+
+const uint8_t CC_TRX_TIMEOUT = 100; /* (ms) Max time to wait for reply from TRX */
+const uint8_t CC_TRX_TIMEOUT_MIN = 20; /* (ms) Min time to wait, however quick the TRX's learned RTT */
+const uint8_t RETRY_SPREAD = 4; /* Spread retries over 1/RETRY_SPREAD of what's left of the period */
+const uint8_t INTER_TRX_DELAY = 10; /* (ms) Min gap between polls so we don't completely saturate the airwaves. */
+const uint8_t MAX_PENDING_POLLS = 3; /* Max num TRX polls awaiting a reply at any one time */
+
+/* Max num TRXs which CcTrxArray queues for a retry each roll call.  Costs
+ * sizeof(index_t) bytes each.  Beyond this, retries scan every TRX. */
+const uint8_t CC_TRX_RETRY_QUEUE_LENGTH = 16;
+
+/* A TRX which misses TRX_DEMOTE_AFTER_MISSES polls in a row is demoted:
+ * it's no longer retried and is only probed once every few roll calls,
+ * backing off exponentially up to TRX_MAX_PROBE_INTERVAL roll calls.
+ * So a TRX is retried at most TRX_DEMOTE_AFTER_MISSES - 1 times in a
+ * row.  See CcTrx::missed_poll(). */
+const uint8_t TRX_DEMOTE_AFTER_MISSES = 3;
+const uint8_t TRX_MAX_PROBE_INTERVAL = 64; /* roll calls */
+
+/* Adaptive polling (see CcTrx::update_poll_interval()).  A TRX whose
+ * reading changes by more than ADAPTIVE_POLL_DEADBAND watts is polled
+ * every roll call.  Once its reading has stayed within the deadband for
+ * ADAPTIVE_POLL_STABLE_REPLIES replies in a row, its poll interval
+ * doubles with each further stable reply, up to the max interval set
+ * with the 'i' serial command. */
+const watts_t ADAPTIVE_POLL_DEADBAND = 5;
+const uint8_t ADAPTIVE_POLL_STABLE_REPLIES = 2;
+const uint8_t DEFAULT_MAX_POLL_INTERVAL = 1; /* roll calls; 1 disables adaptive polling */
+
+/* Report-on-change (see LastReport::report_due()), switched on with the 'o'
+ * serial command.  A TRX's reading is only printed if it differs from
+ * the last one printed by more than REPORT_DEADBAND watts *and* more
+ * than REPORT_DEADBAND_PCT percent, or if nothing has been printed for
+ * it for REPORT_HEARTBEAT seconds.  All three can be changed over serial. */
+const watts_t  DEFAULT_REPORT_DEADBAND     = 5;   /* watts */
+const uint8_t  DEFAULT_REPORT_DEADBAND_PCT = 5;   /* percent */
+const uint16_t DEFAULT_REPORT_HEARTBEAT    = 300; /* seconds */
+
+/* Hash indices over known CC TX and CC TRX IDs make finding the sender
+ * of each packet O(1) (see IdHashIndex.h).  Each costs
+ * *_HASH_SLOTS * sizeof(index_t) bytes of RAM and indexes up to
+ * ID_HASH_MAX_LOAD percent of that many sensors: 6 TXs and 48 TRXs as
+ * shipped, which is 144 bytes.  Beyond that the index switches itself
+ * off and DynamicArray::find() searches instead, in O(log n).  Doubling
+ * CC_TRX_HASH_SLOTS doubles both; the compile-time check against
+ * RAM_BUDGET says whether it fits.  Comment out ID_HASH_INDEX to save
+ * the RAM and always search. */
+#define ID_HASH_INDEX
+#ifndef CC_TX_HASH_SLOTS
+#define CC_TX_HASH_SLOTS 8    /* must be a power of two */
+#endif
+#ifndef CC_TRX_HASH_SLOTS
+#define CC_TRX_HASH_SLOTS 64  /* must be a power of two */
+#endif
+const uint8_t ID_HASH_MAX_LOAD = 75; /* percent */
+
+/* With STATIC_ARRAYS, CC TXs and TRXs live in fixed-size arrays of
+ * CC_TX_CAPACITY and CC_TRX_CAPACITY items inside Manager (see
+ * StaticArray.h) instead of on the heap, so pairing can never run out of
+ * heap or fragment it.  s/S can't grow them.  Uncomment to use. */
+// #define STATIC_ARRAYS
+#ifndef CC_TX_CAPACITY
+#define CC_TX_CAPACITY 4
+#endif
+#ifndef CC_TRX_CAPACITY
+#define CC_TRX_CAPACITY 16
+#endif
+
+/* Bytes of the ATmega328's 2048 which our globals may take.  The rest is
+ * for the stack, the heap (DynamicArrays, aggregates) and the Arduino
+ * core's serial buffers.  Checked at compile time in
+ * rfm_edf_ecomanager.cpp; with STATIC_ARRAYS that includes the arrays. */
+const uint16_t RAM_BUDGET = 1536;
+
+/* With LAZY_DECODE the RFM12b ISR only marks each packet done; the
+ * main loop checks and decodes each packet as it pops it from
+ * RxPacketFromSensor::ready_packets (see RxPacketFromSensor::decode()).
+ * Comment out to decode in the ISR as soon as the last byte arrives. */
+#define LAZY_DECODE
+
+/* Bytes of serial output which can wait to be sent (see SerialTx).
+ * A JSON TRX reading is about 100 bytes.  At most 255. */
+const uint8_t SERIAL_TX_BUFFER_LENGTH = 192;
+
+const millis_t SERIAL_ARG_TIMEOUT = 10000; /* (ms) Give up on a serial command's argument after this */
+
+/* Warm start (see WarmStart.h).  Sensors are saved this long after the
+ * last one is added or removed, so a burst of n/N commands is saved once.
+ * Learned TX timing changes all the time so it's only saved every
+ * WARM_START_TIMING_INTERVAL.  EEPROM cells wear out after ~100,000
+ * writes: hourly saves take over 10 years. */
+const millis_t WARM_START_SAVE_DELAY = 10000;        /* ms */
+const millis_t WARM_START_TIMING_INTERVAL = 3600000; /* ms */
+const uint8_t  WARM_START_BYTES_PER_RUN = 32; /* max bytes compared per Manager::run() */
 
 #endif /* CONSTS_H_ */
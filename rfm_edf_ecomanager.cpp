@@ -17,6 +17,12 @@
 
 Manager manager;
 
+/* Compile-time check that our globals fit in RAM_BUDGET (see consts.h).
+ * (C++03 doesn't have static_assert.) */
+typedef char globals_exceed_ram_budget[
+        sizeof(Manager) + sizeof(SerialTx) +
+        sizeof(RxPacketFromSensor::ready_packets) <= RAM_BUDGET ? 1 : -1];
+
 void setup()
 {
     Serial.begin(115200);
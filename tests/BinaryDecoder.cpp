@@ -0,0 +1,144 @@
+/*
+ * BinaryDecoder.cpp
+ *
+ * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
+ * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
+ * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE
+ * QUALITY AND PERFORMANCE OF THE PROGRAM IS WITH YOU. SHOULD THE PROGRAM PROVE
+ * DEFECTIVE, YOU ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ */
+
+#include "BinaryDecoder.h"
+
+namespace binary_decoder {
+
+size_t cobs_decode(const uint8_t* src, const size_t length, uint8_t* dst)
+{
+    size_t src_i = 0, dst_i = 0;
+
+    while (src_i < length) {
+        const uint8_t code = src[src_i++];
+        if (code == 0x00 || src_i + code - 1 > length) {
+            return 0;
+        }
+        for (uint8_t j=1; j<code; j++) {
+            dst[dst_i++] = src[src_i++];
+        }
+        if (code < 0xFF && src_i < length) {
+            dst[dst_i++] = 0x00;
+        }
+    }
+
+    return dst_i;
+}
+
+
+static uint32_t read_uint32(const uint8_t* bytes)
+{
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) |
+            ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+
+bool decode_record(const uint8_t* record, const size_t length, Reading& reading)
+{
+    if (length != RECORD_LENGTH) {
+        return false;
+    }
+
+    uint8_t checksum = 0;
+    for (size_t j=0; j<RECORD_LENGTH-1; j++) {
+        checksum += record[j];
+    }
+    if (checksum != record[RECORD_LENGTH-1]) {
+        return false;
+    }
+
+    if (record[0] != TYPE_CC_TX && record[0] != TYPE_CC_TRX) {
+        return false;
+    }
+
+    reading.type = record[0];
+    reading.id = read_uint32(record+1);
+    reading.timecode = read_uint32(record+5);
+    for (size_t sensor=0; sensor<3; sensor++) {
+        reading.watts[sensor] = record[9+sensor*2] | (record[10+sensor*2] << 8);
+    }
+    reading.state = record[15];
+    reading.reply_to_poll = record[16];
+
+    return true;
+}
+
+
+bool decode_frame(const uint8_t* frame, const size_t length, Reading& reading)
+{
+    uint8_t record[RECORD_LENGTH + 1];
+
+    if (length != RECORD_LENGTH + 1) {
+        return false;
+    }
+
+    const size_t decoded_length = cobs_decode(frame, length, record);
+    return decode_record(record, decoded_length, reading);
+}
+
+
+/******************************
+ * StreamDecoder              *
+ ******************************/
+
+StreamDecoder::StreamDecoder()
+: frames_ok(0), frames_bad(0), in_frame(false), last_reading() {}
+
+
+StreamDecoder::Result StreamDecoder::feed(const uint8_t& byte)
+{
+    Result result = NOTHING;
+
+    if (in_frame) {
+        if (byte == 0x00) {
+            if (chunk.empty()) {
+                return NOTHING; // trailing delimiter followed by leading delimiter
+            }
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(chunk.data());
+            if (decode_frame(bytes, chunk.size(), last_reading)) {
+                frames_ok++;
+                result = READING;
+            } else {
+                frames_bad++;
+            }
+            chunk.clear();
+            in_frame = false;
+        } else {
+            chunk += (char)byte;
+            if (chunk.size() > RECORD_LENGTH + 1) {
+                /* Too long to be a frame so we must have lost sync
+                 * and this is text. */
+                in_frame = false;
+            }
+        }
+    } else {
+        if (byte == 0x00) {
+            if (!chunk.empty()) {
+                last_text = chunk;
+                result = TEXT;
+            }
+            chunk.clear();
+            in_frame = true;
+        } else {
+            chunk += (char)byte;
+            if (byte == '\n') {
+                last_text = chunk;
+                chunk.clear();
+                result = TEXT;
+            }
+        }
+    }
+
+    return result;
+}
+
+} // namespace binary_decoder
@@ -0,0 +1,110 @@
+/*
+ * BinaryDecoder.h
+ *
+ * Host-side decoder for the binary output format selected with the 'x'
+ * serial command (see RxPacketFromSensor::print_binary()).
+ *
+ * Each reading is sent as one frame:
+ *
+ *   0x00, COBS(record), 0x00
+ *
+ * where record is BINARY_RECORD_LENGTH bytes, little-endian:
+ *
+ *   offset  size  field
+ *        0     1  type: 0x01 = CC TX, 0x02 = CC TRX
+ *        1     4  id
+ *        5     4  timecode (millis() on the Nanode when the packet arrived)
+ *        9     6  watts[3] (0xFFFF if the sensor isn't plugged in)
+ *       15     1  state: 1 = on, 0 = off, 0xFF for CC TXs
+ *       16     1  reply_to_poll: 1 if this was a reply to a poll
+ *       17     1  checksum: sum of bytes 0-16, modulo 256
+ *
+ * Everything else the Nanode prints (ACKs, pairing messages etc) is still
+ * text, which never contains 0x00.  StreamDecoder uses the delimiters
+ * to separate frames from lines of text.
+ *
+ * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
+ * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
+ * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE
+ * QUALITY AND PERFORMANCE OF THE PROGRAM IS WITH YOU. SHOULD THE PROGRAM PROVE
+ * DEFECTIVE, YOU ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ */
+
+#ifndef BINARYDECODER_H_
+#define BINARYDECODER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+namespace binary_decoder {
+
+const size_t  RECORD_LENGTH = 18;
+const uint8_t TYPE_CC_TX    = 0x01;
+const uint8_t TYPE_CC_TRX   = 0x02;
+const uint16_t WATTS_NONE   = 0xFFFF;
+const uint8_t STATE_NONE    = 0xFF;
+
+struct Reading {
+    uint8_t  type;
+    uint32_t id;
+    uint32_t timecode;
+    uint16_t watts[3];
+    uint8_t  state;
+    bool     reply_to_poll;
+};
+
+/**
+ * Decode COBS-encoded src (without delimiters) into dst.
+ *
+ * @param dst must have room for length bytes
+ * @return number of decoded bytes, or 0 if src isn't valid COBS
+ */
+size_t cobs_decode(const uint8_t* src, const size_t length, uint8_t* dst);
+
+/**
+ * Unpack a decoded record.
+ *
+ * @return false if length or checksum is wrong
+ */
+bool decode_record(const uint8_t* record, const size_t length, Reading& reading);
+
+/**
+ * cobs_decode() then decode_record().
+ */
+bool decode_frame(const uint8_t* frame, const size_t length, Reading& reading);
+
+
+/**
+ * Feed bytes from the serial port one at a time.
+ */
+class StreamDecoder {
+public:
+    enum Result {NOTHING, READING, TEXT};
+
+    StreamDecoder();
+
+    /**
+     * @return READING when a complete frame has been decoded (see reading()),
+     *         TEXT when a line of text has ended (see text()),
+     *         NOTHING otherwise.
+     */
+    Result feed(const uint8_t& byte);
+
+    const Reading& reading() const { return last_reading; }
+    const std::string& text() const { return last_text; }
+
+    unsigned long frames_ok, frames_bad;
+
+private:
+    std::string chunk;
+    bool in_frame; /* seen a leading delimiter but not the trailing one */
+    Reading last_reading;
+    std::string last_text;
+};
+
+} // namespace binary_decoder
+
+#endif /* BINARYDECODER_H_ */
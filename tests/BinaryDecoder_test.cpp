@@ -0,0 +1,171 @@
+/*
+ * BinaryDecoder_test.cpp
+ *
+ * Round-trips RxPacketFromSensor::encode_binary() through the host-side
+ * decoder in BinaryDecoder.h.
+ */
+
+#include <iostream>
+#include <tests/FakeArduino.h>
+#include "../RxPacketFromSensor.h"
+#include "BinaryDecoder.h"
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE BinaryDecoderTest
+#include <boost/test/unit_test.hpp>
+
+using namespace binary_decoder;
+
+void append_array(RxPacketFromSensor& rx_packet,
+        const byte data[], const index_t length)
+{
+    for (index_t i=0; i<length; i++){
+        rx_packet.append(data[i]);
+    }
+    rx_packet.decode();
+}
+
+BOOST_AUTO_TEST_CASE(txRoundTrip)
+{
+    RxPacketFromSensor rx_packet;
+
+    const byte data[] = {
+            0x55, 0xA6, 0x6A, 0xAA, 0x95, 0x55, 0x9A, 0x65,
+            0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55  };
+
+    append_array(rx_packet, data, 16);
+    BOOST_REQUIRE(rx_packet.is_ok());
+
+    byte frame[RxPacketFromSensor::BINARY_FRAME_LENGTH];
+    const index_t length = rx_packet.encode_binary(frame);
+
+    BOOST_CHECK_EQUAL(length, RxPacketFromSensor::BINARY_FRAME_LENGTH);
+    BOOST_CHECK_EQUAL(frame[0], 0x00);
+    BOOST_CHECK_EQUAL(frame[length-1], 0x00);
+    for (index_t i=1; i<length-1; i++) {
+        BOOST_CHECK(frame[i] != 0x00);
+    }
+
+    Reading reading;
+    BOOST_REQUIRE(decode_frame(frame+1, length-2, reading));
+    BOOST_CHECK_EQUAL(reading.type, TYPE_CC_TX);
+    BOOST_CHECK_EQUAL(reading.id, 3455);
+    BOOST_CHECK_EQUAL(reading.timecode, rx_packet.get_timecode());
+    BOOST_CHECK_EQUAL(reading.watts[0], 180);
+    BOOST_CHECK_EQUAL(reading.watts[1], WATTS_NONE);
+    BOOST_CHECK_EQUAL(reading.watts[2], WATTS_NONE);
+    BOOST_CHECK_EQUAL(reading.state, STATE_NONE);
+    BOOST_CHECK(!reading.reply_to_poll);
+}
+
+BOOST_AUTO_TEST_CASE(manyZeros)
+{
+    // ID 77 and 0 watts, so most of the record is zeros
+    RxPacketFromSensor rx_packet;
+
+    const byte data[] = {
+            0x55, 0x55, 0x65, 0xA6, 0x95, 0x55, 0x55, 0x55,
+            0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55  };
+
+    append_array(rx_packet, data, 16);
+    BOOST_REQUIRE(rx_packet.is_ok());
+
+    byte frame[RxPacketFromSensor::BINARY_FRAME_LENGTH];
+    const index_t length = rx_packet.encode_binary(frame, true);
+
+    Reading reading;
+    BOOST_REQUIRE(decode_frame(frame+1, length-2, reading));
+    BOOST_CHECK_EQUAL(reading.id, 77);
+    BOOST_CHECK_EQUAL(reading.watts[0], 0);
+    BOOST_CHECK(reading.reply_to_poll);
+}
+
+BOOST_AUTO_TEST_CASE(corruptFrame)
+{
+    RxPacketFromSensor rx_packet;
+
+    const byte data[] = {
+            0x55, 0xA6, 0x6A, 0xAA, 0x95, 0x55, 0x9A, 0x65,
+            0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55  };
+
+    append_array(rx_packet, data, 16);
+
+    byte frame[RxPacketFromSensor::BINARY_FRAME_LENGTH];
+    const index_t length = rx_packet.encode_binary(frame);
+
+    Reading reading;
+    frame[5] ^= 0x01;
+    BOOST_CHECK(!decode_frame(frame+1, length-2, reading));
+    frame[5] ^= 0x01;
+    BOOST_CHECK(!decode_frame(frame+1, length-3, reading)); // truncated
+}
+
+BOOST_AUTO_TEST_CASE(handBuiltTrxRecord)
+{
+    const uint8_t record[RECORD_LENGTH] = {
+            TYPE_CC_TRX,
+            0x78, 0x56, 0x34, 0x12,  // id
+            0xE8, 0x03, 0x00, 0x00,  // timecode
+            0x64, 0x00,              // watts[0]
+            0xFF, 0xFF, 0xFF, 0xFF,  // watts[1], watts[2]
+            0x01,                    // state
+            0x01,                    // reply_to_poll
+            0x00};                   // checksum (below)
+
+    uint8_t with_checksum[RECORD_LENGTH];
+    uint8_t checksum = 0;
+    for (size_t j=0; j<RECORD_LENGTH-1; j++) {
+        with_checksum[j] = record[j];
+        checksum += record[j];
+    }
+    with_checksum[RECORD_LENGTH-1] = checksum;
+
+    Reading reading;
+    BOOST_REQUIRE(decode_record(with_checksum, RECORD_LENGTH, reading));
+    BOOST_CHECK_EQUAL(reading.type, TYPE_CC_TRX);
+    BOOST_CHECK_EQUAL(reading.id, 0x12345678);
+    BOOST_CHECK_EQUAL(reading.timecode, 1000);
+    BOOST_CHECK_EQUAL(reading.watts[0], 100);
+    BOOST_CHECK_EQUAL(reading.state, 1);
+    BOOST_CHECK(reading.reply_to_poll);
+}
+
+BOOST_AUTO_TEST_CASE(streamMixedWithText)
+{
+    RxPacketFromSensor rx_packet;
+    const byte data[] = {
+            0x55, 0xA6, 0x6A, 0xAA, 0x95, 0x55, 0x9A, 0x65,
+            0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55  };
+    append_array(rx_packet, data, 16);
+
+    byte frame[RxPacketFromSensor::BINARY_FRAME_LENGTH];
+    const index_t length = rx_packet.encode_binary(frame);
+
+    std::string stream = "ACK binary output\r\n";
+    stream.append((const char*)frame, length);
+    stream.append((const char*)frame, length);
+    stream += "{\"pw\": {\"type\": \"tx\", \"id\": 5} }\r\n";
+    stream.append((const char*)frame, length);
+
+    StreamDecoder decoder;
+    std::vector<std::string> texts;
+    unsigned readings = 0;
+    for (size_t j=0; j<stream.size(); j++) {
+        switch (decoder.feed(stream[j])) {
+        case StreamDecoder::READING:
+            readings++;
+            BOOST_CHECK_EQUAL(decoder.reading().id, 3455);
+            break;
+        case StreamDecoder::TEXT:
+            texts.push_back(decoder.text());
+            break;
+        case StreamDecoder::NOTHING:
+            break;
+        }
+    }
+
+    BOOST_CHECK_EQUAL(readings, 3);
+    BOOST_CHECK_EQUAL(decoder.frames_bad, 0);
+    BOOST_REQUIRE_EQUAL(texts.size(), 2);
+    BOOST_CHECK_EQUAL(texts[0], "ACK binary output\r\n");
+    BOOST_CHECK_EQUAL(texts[1], "{\"pw\": {\"type\": \"tx\", \"id\": 5} }\r\n");
+}
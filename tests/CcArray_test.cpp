@@ -6,8 +6,10 @@
  */
 
 #include <iostream>
+#include <vector>
 
 #include "../CcTx.h"
+#include "../LastReport.h"
 #define BOOST_TEST_DYN_LINK
 #define BOOST_TEST_MODULE CcTxArrayTest
 #include <boost/test/unit_test.hpp>
@@ -117,6 +119,41 @@ BOOST_AUTO_TEST_CASE(testAppend)
 }
 
 
+BOOST_AUTO_TEST_CASE(bulkAppend)
+{
+    CcTxArray cc_txs = make_cc_tx_array(); // 5, 10, ... 100
+
+    // Below, between, duplicate (of existing and within batch) and above
+    id_t batch[] = {1, 2, 12, 15, 41, 41, 42, 100, 101, 200};
+    BOOST_CHECK_EQUAL(cc_txs.append(batch, 10), 7);
+    BOOST_CHECK_EQUAL(cc_txs.get_n(), 27);
+
+    id_t expected[] = {1, 2, 5, 10, 12, 15, 20, 25, 30, 35, 40, 41, 42, 45,
+            50, 55, 60, 65, 70, 75, 80, 85, 90, 95, 100, 101, 200};
+    for (uint8_t i=0; i<27; i++) {
+        BOOST_CHECK_EQUAL(cc_txs[i].id, expected[i]);
+    }
+    BOOST_CHECK(cc_txs.find(1));
+    BOOST_CHECK(cc_txs.find(200));
+    BOOST_CHECK(cc_txs.find(42));
+
+    // Nothing new
+    BOOST_CHECK_EQUAL(cc_txs.append(batch, 10), 0);
+
+    // Unsorted batches are rejected
+    id_t unsorted[] = {300, 250};
+    BOOST_CHECK_EQUAL(cc_txs.append(unsorted, 2), 0);
+    BOOST_CHECK_EQUAL(cc_txs.get_n(), 27);
+
+    // Into an empty array
+    CcTrxArray cc_trxs;
+    BOOST_CHECK_EQUAL(cc_trxs.append(batch, 10), 9);
+    BOOST_CHECK_EQUAL(cc_trxs[0].id, 1);
+    BOOST_CHECK_EQUAL(cc_trxs[8].id, 200);
+    BOOST_CHECK(cc_trxs.find(41));
+}
+
+
 BOOST_AUTO_TEST_CASE(copyConstructor)
 {
     CcTxArray cc_txs = make_cc_tx_array();
@@ -389,3 +426,542 @@ BOOST_AUTO_TEST_CASE(remove_id)
 
 }
 
+
+BOOST_AUTO_TEST_CASE(trxTimeout)
+{
+    CcTrx trx(1);
+
+    // No samples yet so wait as long as we're allowed
+    BOOST_CHECK_EQUAL(trx.get_rtt(), 0);
+    BOOST_CHECK_EQUAL(trx.get_timeout(), CC_TRX_TIMEOUT);
+
+    // Steady RTT: deviation decays so timeout approaches RTT,
+    // but never drops below CC_TRX_TIMEOUT_MIN
+    for (uint8_t j=0; j<50; j++) {
+        trx.add_rtt_sample(12);
+    }
+    BOOST_CHECK_EQUAL(trx.get_rtt(), 12);
+    BOOST_CHECK_EQUAL(trx.get_timeout(), CC_TRX_TIMEOUT_MIN);
+
+    // Jittery RTT: timeout covers the spread
+    CcTrx jittery(2);
+    for (uint8_t j=0; j<50; j++) {
+        jittery.add_rtt_sample(j%2 ? 20 : 40);
+    }
+    BOOST_CHECK(jittery.get_rtt() >= 25 && jittery.get_rtt() <= 35);
+    BOOST_CHECK(jittery.get_timeout() > 40);
+    BOOST_CHECK(jittery.get_timeout() < CC_TRX_TIMEOUT);
+
+    // Impossible samples are ignored
+    jittery.add_rtt_sample(CC_TRX_TIMEOUT + 1);
+    jittery.add_rtt_sample(0xFFFFFFF0); // reply timecode before poll was sent
+    BOOST_CHECK(jittery.get_rtt() >= 25 && jittery.get_rtt() <= 35);
+}
+
+class HashedTrxArray : public DynamicArray<CcTrx, GrowGeometric, IdHashIndex<16> > {
+public:
+    void print_name() const {}
+    bool index_enabled() const { return id_index.is_enabled(); }
+};
+
+/* Check every ID is found at the right index by both find()s */
+void check_all_found(const HashedTrxArray& array)
+{
+    for (index_t i=0; i<array.get_n(); i++) {
+        index_t index = 0xFF;
+        BOOST_CHECK(array.find(array[i].id));
+        BOOST_CHECK(array.find(array[i].id, index));
+        BOOST_CHECK_EQUAL(index, i);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(hashIndex)
+{
+    HashedTrxArray array;
+    index_t index;
+
+    // Sequential and clustered IDs, which collide most in a naive hash
+    for (id_t id=100; id<106; id++) {
+        BOOST_CHECK(array.append(id));
+    }
+    id_t clustered[] = {0x10000000, 0x10000010, 0x10000020, 0x10000040, 0x20000000, 0xFFFFFFF0};
+    BOOST_CHECK_EQUAL(array.append(clustered, 6), 6);
+    BOOST_CHECK(array.index_enabled());
+    check_all_found(array);
+
+    BOOST_CHECK(!array.find(99));
+    BOOST_CHECK(!array.find(106, index));
+    BOOST_CHECK_EQUAL(index, 6); // upper bound still works
+    BOOST_CHECK(!array.find(0x10000030));
+
+    // Removing shifts indices; the index must follow
+    BOOST_CHECK(array.remove_id(100));
+    BOOST_CHECK(!array.find(100));
+    check_all_found(array);
+
+    // 12 items is the most 16 slots at 75% load can hold
+    BOOST_CHECK(array.append(1));
+    BOOST_CHECK(array.index_enabled());
+    check_all_found(array);
+    BOOST_CHECK(array.append(2));
+    BOOST_CHECK(!array.index_enabled()); // falls back to searching
+    check_all_found(array);
+    BOOST_CHECK(!array.find(3));
+
+    array.delete_all();
+    BOOST_CHECK(array.index_enabled());
+    BOOST_CHECK(!array.find(101));
+    BOOST_CHECK(!array.find(2));
+}
+
+class StaticTrxArray : public StaticArray<CcTrx, 8, IdHashIndex<16> > {
+public:
+    void print_name() const {}
+};
+
+BOOST_AUTO_TEST_CASE(staticArray)
+{
+    StaticTrxArray array;
+    index_t index;
+    BOOST_CHECK_EQUAL(array.get_size(), 8);
+
+    // Same behaviour as DynamicArray until it's full...
+    id_t batch[] = {10, 20, 30, 40, 50};
+    BOOST_CHECK_EQUAL(array.append(batch, 5), 5);
+    BOOST_CHECK(array.append(35));
+    BOOST_CHECK(array.append(5));
+    BOOST_CHECK(array.append(60));
+    BOOST_CHECK_EQUAL(array.get_n(), 8);
+    BOOST_CHECK(array.find(35, index));
+    BOOST_CHECK_EQUAL(index, 4);
+    BOOST_CHECK(!array.find(36, index));
+    BOOST_CHECK_EQUAL(index, 5);
+
+    // ...then appends fail and leave it unchanged
+    BOOST_CHECK(!array.append(1));
+    id_t more[] = {1, 2};
+    BOOST_CHECK_EQUAL(array.append(more, 2), 0);
+    BOOST_CHECK_EQUAL(array.get_n(), 8);
+    BOOST_CHECK_EQUAL(array[0].id, 5);
+    BOOST_CHECK_EQUAL(array[7].id, 60);
+
+    // Room again once one's removed
+    BOOST_CHECK(array.remove_id(35));
+    BOOST_CHECK(!array.find(35));
+    BOOST_CHECK(array.append(1));
+    BOOST_CHECK(array.find(60, index));
+    BOOST_CHECK_EQUAL(index, 7);
+
+    // Capacity is fixed
+    BOOST_CHECK(array.set_size(4));
+    BOOST_CHECK(!array.set_size(9));
+    BOOST_CHECK_EQUAL(array.get_size(), 8);
+    BOOST_CHECK_EQUAL(array.get_n(), 8);
+
+    // Copies have their own buffer
+    StaticTrxArray copy(array);
+    copy.remove_id(1);
+    BOOST_CHECK(array.find(1));
+    BOOST_CHECK(!copy.find(1));
+    BOOST_CHECK(copy.find(60, index));
+    BOOST_CHECK_EQUAL(index, 6);
+    copy = array;
+    BOOST_CHECK(copy.find(1));
+
+    array.delete_all();
+    BOOST_CHECK_EQUAL(array.get_n(), 0);
+    BOOST_CHECK(array.append(70));
+}
+
+BOOST_AUTO_TEST_CASE(txEtaHeap)
+{
+    CcTxArray cc_txs;
+    const index_t N = 5;
+
+    for (id_t id=1; id<=N; id++) {
+        BOOST_CHECK(cc_txs.append(id));
+    }
+
+    // Every TX starts with the same ETA.  Each time the current TX
+    // misses its window it moves back a period so the others get a turn.
+    const millis_t first_eta = cc_txs.current().get_eta();
+    bool seen[N+1] = {false};
+    for (index_t j=0; j<N; j++) {
+        BOOST_CHECK_EQUAL(cc_txs.current().get_eta(), first_eta);
+        BOOST_CHECK(!seen[cc_txs.current().id]);
+        seen[cc_txs.current().id] = true;
+        cc_txs.current_missing();
+    }
+    BOOST_CHECK_EQUAL(cc_txs.current().get_eta(), first_eta + SAMPLE_PERIOD);
+
+    // Keep missing until TXs go inactive; the heap must stay consistent
+    // with a linear scan throughout.  ETAs roll over along the way.
+    for (index_t j=0; j<N*8; j++) {
+        const CcTx* earliest_active = NULL;
+        for (index_t k=0; k<cc_txs.get_n(); k++) {
+            if (cc_txs[k].active && (earliest_active == NULL ||
+                    (int32_t)(cc_txs[k].get_eta() - earliest_active->get_eta()) < 0)) {
+                earliest_active = &cc_txs[k];
+            }
+        }
+        if (earliest_active) {
+            BOOST_CHECK(cc_txs.current().active);
+            BOOST_CHECK_EQUAL(cc_txs.current().get_eta(), earliest_active->get_eta());
+        }
+        cc_txs.current_missing();
+    }
+
+    // Removing and adding TXs rebuilds the heap
+    BOOST_CHECK(cc_txs.remove_id(cc_txs.current().id));
+    BOOST_CHECK(cc_txs.append(100));
+    BOOST_CHECK_EQUAL(cc_txs.current().id, 100); // only active TX
+}
+
+
+BOOST_AUTO_TEST_CASE(txEtaHeapRollOver)
+{
+    CcTxArray cc_txs;
+    BOOST_CHECK(cc_txs.append(1));
+    BOOST_CHECK(cc_txs.append(2));
+
+    // New TXs are due just before millis() rolls over.  Miss both once,
+    // then miss the current one again so its ETA rolls over to near 0.
+    BOOST_CHECK(cc_txs.current().get_eta() > 0xFFFFFFFF - 2 * SAMPLE_PERIOD);
+    cc_txs.current_missing();
+    cc_txs.current_missing();
+    const id_t rolled_over = cc_txs.current().id;
+    cc_txs.current_missing();
+    index_t i;
+    BOOST_CHECK(cc_txs.find(rolled_over, i));
+    BOOST_CHECK(cc_txs[i].get_eta() < SAMPLE_PERIOD);
+
+    // The other TX's window opens before the roll-over, so it's next
+    BOOST_CHECK(cc_txs.current().id != rolled_over);
+    BOOST_CHECK(cc_txs.current().get_eta() > 0xFFFFFFFF - SAMPLE_PERIOD);
+}
+
+
+BOOST_AUTO_TEST_CASE(txEtaPredictor)
+{
+    CcTx tx(1);
+
+    // Period is a little off nominal and not a whole number of ms.
+    // Arrivals jitter by +/- 2ms.
+    const double period = 6047.3;
+    const double start = 12345;
+    srand(3);
+
+    millis_t timecode = 0;
+    for (int k=0; k<=200; k++) { // k=200 wasn't missed
+        timecode = start + k*period + (rand() % 5) - 2;
+
+        if (k % 7 == 3) {
+            // Missed this one.  Manager would call missing().
+            tx.missing();
+            continue;
+        }
+        if (k > 20) {
+            // Predictions shouldn't drift, whether or not we missed
+            // the previous packet
+            const millis_t expected = start + k*period;
+            BOOST_CHECK(tx.get_eta() + 4 >= expected && tx.get_eta() <= expected + 4);
+        }
+        tx.update(timecode);
+        if (k > 20) {
+            BOOST_CHECK(tx.get_eta_error() >= -5 && tx.get_eta_error() <= 5);
+        }
+    }
+    BOOST_CHECK(tx.get_period() == 6047);
+    BOOST_CHECK(tx.get_eta_error_sd() <= 3);
+
+    // A repeat of the last packet changes nothing
+    const millis_t eta = tx.get_eta();
+    tx.update(timecode + 100);
+    BOOST_CHECK_EQUAL(tx.get_eta(), eta);
+
+    // A packet which wasn't missed but turned up late, after Manager
+    // had given up on it, is still matched to the right period
+    tx.missing();
+    tx.update(eta + 300);
+    BOOST_CHECK_EQUAL(tx.get_eta_error(), 300);
+    BOOST_CHECK_EQUAL(tx.get_period(), 6047); // outlier doesn't skew the period
+    BOOST_CHECK_EQUAL(tx.get_eta(), eta + 300 + 6047); // re-synced
+
+    // TX which has been silent for a long time.  ETA must keep moving.
+    CcTx silent(2);
+    for (int k=0; k<600; k++) {
+        const millis_t before = silent.get_eta();
+        silent.missing();
+        BOOST_CHECK(silent.get_eta() != before);
+    }
+    BOOST_CHECK(!silent.active);
+}
+
+
+BOOST_AUTO_TEST_CASE(txWindow)
+{
+    CcTx tx(1);
+    BOOST_CHECK_EQUAL(tx.get_window_open(), CC_TX_WINDOW_OPEN);
+
+    // The window shrinks as we learn that the TX is punctual
+    millis_t timecode = 1000;
+    uint16_t window = tx.get_window_open();
+    for (int k=0; k<10; k++) {
+        tx.update(timecode);
+        BOOST_CHECK(tx.get_window_open() <= window);
+        window = tx.get_window_open();
+        timecode += 6000 + (k % 2);
+    }
+    BOOST_CHECK_EQUAL(tx.get_window_open(), CC_TX_WINDOW_OPEN_MIN);
+
+    // ...widens for each period missed in a row...
+    tx.missing();
+    BOOST_CHECK_EQUAL(tx.get_window_open(), CC_TX_WINDOW_OPEN_MIN * 2);
+    tx.missing();
+    BOOST_CHECK_EQUAL(tx.get_window_open(), CC_TX_WINDOW_OPEN_MIN * 4);
+    for (int k=0; k<5; k++) {
+        tx.missing();
+    }
+    BOOST_CHECK_EQUAL(tx.get_window_open(), CC_TX_WINDOW_OPEN);
+
+    // ...and when arrivals get jittery
+    timecode = tx.get_eta();
+    tx.update(timecode);
+    BOOST_CHECK_EQUAL(tx.get_window_open(), CC_TX_WINDOW_OPEN_MIN);
+    timecode = tx.get_eta() + 60;
+    tx.update(timecode);
+    const uint16_t jittery_window = tx.get_window_open();
+    BOOST_CHECK(jittery_window >= 60);
+
+    // then shrinks back once the jitter has passed
+    for (int k=0; k<10; k++) {
+        timecode = tx.get_eta();
+        tx.update(timecode);
+    }
+    BOOST_CHECK(tx.get_window_open() < jittery_window);
+    BOOST_CHECK_EQUAL(tx.get_window_open(), CC_TX_WINDOW_OPEN_MIN);
+}
+
+
+BOOST_AUTO_TEST_CASE(adaptivePolling)
+{
+    CcTrx trx(1);
+    BOOST_CHECK_EQUAL(trx.get_poll_interval(), 1);
+    BOOST_CHECK(trx.due_for_poll());
+
+    // Adaptive polling disabled: every roll call whatever the reading
+    trx.update_poll_interval(100, 1);
+    trx.update_poll_interval(100, 1);
+    BOOST_CHECK_EQUAL(trx.get_poll_interval(), 1);
+    BOOST_CHECK(trx.due_for_poll());
+
+    // Stable reading: interval doubles up to the max
+    const uint8_t expected[] = {2, 4, 8, 8, 8};
+    for (int j=0; j<5; j++) {
+        trx.update_poll_interval(100 + (j % 2) * 5, 8); // within deadband
+        BOOST_CHECK_EQUAL(trx.get_poll_interval(), expected[j]);
+    }
+
+    // Sits out interval-1 roll calls then is due again
+    for (int j=0; j<7; j++) {
+        BOOST_CHECK(!trx.due_for_poll());
+        trx.sit_out_roll_call();
+    }
+    BOOST_CHECK(trx.due_for_poll());
+
+    // A TRX which didn't answer last time is always due
+    trx.update_poll_interval(100, 8);
+    BOOST_CHECK(!trx.due_for_poll());
+    trx.active = false;
+    BOOST_CHECK(trx.due_for_poll());
+    trx.active = true;
+
+    // Changing reading: back to every roll call
+    trx.update_poll_interval(200, 8);
+    BOOST_CHECK_EQUAL(trx.get_poll_interval(), 1);
+    BOOST_CHECK(trx.due_for_poll());
+
+    // One stable reply isn't enough to back off
+    trx.update_poll_interval(2000, 8);
+    trx.update_poll_interval(2000 + ADAPTIVE_POLL_DEADBAND, 8);
+    BOOST_CHECK_EQUAL(trx.get_poll_interval(), 1);
+    trx.update_poll_interval(2000, 8);
+    BOOST_CHECK_EQUAL(trx.get_poll_interval(), 2);
+
+    // Just outside the deadband
+    trx.update_poll_interval(2000 + ADAPTIVE_POLL_DEADBAND + 1, 8);
+    BOOST_CHECK_EQUAL(trx.get_poll_interval(), 1);
+    trx.update_poll_interval(2000, 8);
+    BOOST_CHECK_EQUAL(trx.get_poll_interval(), 1);
+
+    // Lowering the max interval takes effect at the next reply
+    for (int j=0; j<4; j++) {
+        trx.update_poll_interval(2000, 8);
+    }
+    BOOST_CHECK_EQUAL(trx.get_poll_interval(), 8);
+    trx.update_poll_interval(2000, 2);
+    BOOST_CHECK_EQUAL(trx.get_poll_interval(), 2);
+
+    // The largest max interval the 'i' command allows fits the bitfields
+    for (int j=0; j<10; j++) {
+        trx.update_poll_interval(2000, 128);
+    }
+    BOOST_CHECK_EQUAL(trx.get_poll_interval(), 128);
+    for (int j=0; j<127; j++) {
+        BOOST_CHECK(!trx.due_for_poll());
+        trx.sit_out_roll_call();
+    }
+    BOOST_CHECK(trx.due_for_poll());
+}
+
+
+BOOST_AUTO_TEST_CASE(reportOnChange)
+{
+    LastReport report;
+    const watts_t DEADBAND = 5;
+    const uint8_t PCT = 10;
+    const uint16_t HEARTBEAT = 60;
+
+    // The first reading is always reported
+    BOOST_CHECK(report.report_due(100, 0, DEADBAND, PCT, HEARTBEAT));
+
+    // Small load: the absolute deadband wins (10% of 100 is 10)
+    BOOST_CHECK(!report.report_due(105, 1, DEADBAND, PCT, HEARTBEAT));
+    BOOST_CHECK(!report.report_due(110, 2, DEADBAND, PCT, HEARTBEAT));
+    BOOST_CHECK(report.report_due(111, 3, DEADBAND, PCT, HEARTBEAT));
+
+    // Compared with the last *reported* reading, so slow drift is reported
+    BOOST_CHECK(!report.report_due(116, 4, DEADBAND, PCT, HEARTBEAT));
+    BOOST_CHECK(!report.report_due(121, 5, DEADBAND, PCT, HEARTBEAT));
+    BOOST_CHECK(report.report_due(123, 6, DEADBAND, PCT, HEARTBEAT));
+
+    // Big load: the percentage deadband wins, both up and down
+    BOOST_CHECK(report.report_due(2000, 7, DEADBAND, PCT, HEARTBEAT));
+    BOOST_CHECK(!report.report_due(2200, 8, DEADBAND, PCT, HEARTBEAT));
+    BOOST_CHECK(!report.report_due(1800, 9, DEADBAND, PCT, HEARTBEAT));
+    BOOST_CHECK(report.report_due(1799, 10, DEADBAND, PCT, HEARTBEAT));
+
+    // Heartbeat: unchanged readings are reported every HEARTBEAT seconds
+    BOOST_CHECK(!report.report_due(1799, 10 + HEARTBEAT - 1, DEADBAND, PCT, HEARTBEAT));
+    BOOST_CHECK(report.report_due(1799, 10 + HEARTBEAT, DEADBAND, PCT, HEARTBEAT));
+    BOOST_CHECK(!report.report_due(1799, 10 + HEARTBEAT + 1, DEADBAND, PCT, HEARTBEAT));
+
+    // ...even when the seconds counter wraps
+    BOOST_CHECK(report.report_due(1799, 0xFFF0, DEADBAND, PCT, HEARTBEAT));
+    BOOST_CHECK(!report.report_due(1799, (uint16_t)(0xFFF0 + HEARTBEAT - 1), DEADBAND, PCT, HEARTBEAT));
+    BOOST_CHECK(report.report_due(1799, (uint16_t)(0xFFF0 + HEARTBEAT), DEADBAND, PCT, HEARTBEAT));
+
+    // A zero deadband reports every change
+    BOOST_CHECK(report.report_due(1800, 20, 0, 0, HEARTBEAT));
+    BOOST_CHECK(!report.report_due(1800, 21, 0, 0, HEARTBEAT));
+}
+
+
+BOOST_AUTO_TEST_CASE(trxDemotion)
+{
+    CcTrx trx(1);
+    trx.active = false;
+
+    // Retried every roll call until it has missed TRX_DEMOTE_AFTER_MISSES polls
+    for (int j=0; j<TRX_DEMOTE_AFTER_MISSES-1; j++) {
+        trx.missed_poll();
+        BOOST_CHECK(!trx.is_demoted());
+        BOOST_CHECK(trx.due_for_poll());
+    }
+    trx.missed_poll();
+    BOOST_CHECK(trx.is_demoted());
+    BOOST_CHECK_EQUAL(trx.get_poll_interval(), 2);
+
+    // Probe interval doubles with every missed probe, up to the max
+    uint8_t expected = 2;
+    for (int probe=0; probe<10; probe++) {
+        for (int j=0; j<expected-1; j++) {
+            BOOST_CHECK(!trx.due_for_poll());
+            trx.sit_out_roll_call();
+        }
+        BOOST_REQUIRE(trx.due_for_poll());
+        trx.missed_poll();
+        expected = expected < TRX_MAX_PROBE_INTERVAL ? expected * 2 : TRX_MAX_PROBE_INTERVAL;
+        BOOST_CHECK_EQUAL(trx.get_poll_interval(), expected);
+    }
+    BOOST_CHECK_EQUAL(trx.get_poll_interval(), TRX_MAX_PROBE_INTERVAL);
+    BOOST_CHECK_EQUAL(trx.get_consecutive_misses(), TRX_DEMOTE_AFTER_MISSES);
+
+    // Promoted as soon as it answers
+    trx.heard();
+    trx.active = true;
+    BOOST_CHECK(!trx.is_demoted());
+    BOOST_CHECK(trx.due_for_poll());
+    trx.update_poll_interval(100, 8);
+    BOOST_CHECK_EQUAL(trx.get_poll_interval(), 1);
+
+    // Misses only count in a row
+    for (int j=0; j<TRX_DEMOTE_AFTER_MISSES-1; j++) {
+        trx.missed_poll();
+    }
+    trx.heard();
+    trx.missed_poll();
+    BOOST_CHECK(!trx.is_demoted());
+}
+
+
+BOOST_AUTO_TEST_CASE(trxRetryQueue)
+{
+    CcTrxArray trxs;
+    const index_t N = CC_TRX_RETRY_QUEUE_LENGTH * 4;
+    for (index_t j=0; j<N; j++) {
+        trxs.append(j+1);
+    }
+
+    index_t index;
+    BOOST_CHECK(!trxs.peek_retry(index));
+
+    // First in, first out
+    trxs[5].active = false;
+    trxs[2].active = false;
+    trxs.add_retry(5);
+    trxs.add_retry(2);
+    BOOST_CHECK_EQUAL(trxs.get_num_retries(), 2);
+    BOOST_REQUIRE(trxs.peek_retry(index));
+    BOOST_CHECK_EQUAL(index, 5);
+    trxs.pop_retry();
+    BOOST_REQUIRE(trxs.peek_retry(index));
+    BOOST_CHECK_EQUAL(index, 2);
+    trxs.pop_retry();
+    BOOST_CHECK(!trxs.peek_retry(index));
+
+    // Wraps around the ring buffer
+    for (int round=0; round<3; round++) {
+        for (index_t j=0; j<CC_TRX_RETRY_QUEUE_LENGTH - 1; j++) {
+            trxs.add_retry(j);
+        }
+        for (index_t j=0; j<CC_TRX_RETRY_QUEUE_LENGTH - 1; j++) {
+            BOOST_REQUIRE(trxs.peek_retry(index));
+            BOOST_CHECK_EQUAL(index, j);
+            trxs.pop_retry();
+        }
+        BOOST_CHECK(!trxs.peek_retry(index));
+    }
+
+    // Overflow: once the queue is empty, scan for inactive TRXs
+    for (index_t j=0; j<N; j++) {
+        trxs[j].active = (j % 3 != 0);
+        if (!trxs[j].active) {
+            trxs.add_retry(j);
+        }
+    }
+    std::vector<index_t> retried;
+    while (trxs.peek_retry(index)) {
+        retried.push_back(index);
+        trxs.pop_retry();
+    }
+    BOOST_CHECK_EQUAL(retried.size(), CC_TRX_RETRY_QUEUE_LENGTH + (N + 2) / 3);
+    for (size_t j=0; j<retried.size(); j++) {
+        BOOST_CHECK(!trxs[retried[j]].active);
+    }
+
+    // Adding or removing TRXs invalidates the queue
+    trxs.add_retry(0);
+    trxs.append(N+1);
+    BOOST_CHECK(!trxs.peek_retry(index));
+}
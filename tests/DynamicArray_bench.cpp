@@ -0,0 +1,122 @@
+/*
+ * DynamicArray_bench.cpp
+ *
+ * Counts heap allocations and item copies made by DynamicArray when
+ * appending 10, 100 and 1000 IDs (in random order, as pairing would)
+ * using:
+ *   - append(id) with the old GrowByOne policy
+ *   - append(id) with the default GrowGeometric policy
+ *   - a single append(ids, count) of the sorted batch
+ *
+ * Returns non-zero if geometric growth doesn't allocate less than
+ * growing by one, or if the bulk append doesn't copy each item at most
+ * about once.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <algorithm>
+#include <vector>
+#include <tests/FakeArduino.h>
+#include <Logger.h>
+#include "../DynamicArray.h"
+
+static unsigned long allocations = 0;
+static unsigned long copies = 0;
+
+void* operator new[](size_t size)
+{
+    allocations++;
+    void* p = malloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete[](void* p) throw() { free(p); }
+void operator delete[](void* p, size_t) throw() { free(p); }
+
+
+/* Minimal item which counts how many times it's copied */
+class Item {
+public:
+    Item(): id(ID_INVALID) {}
+    Item(const id_t& _id): id(_id) {}
+    Item& operator=(const Item& src) { id = src.id; copies++; return *this; }
+    void print() const {}
+    id_t id;
+};
+
+
+template <class growth_t>
+class Array : public DynamicArray<Item, growth_t> {
+public:
+    void print_name() const {}
+};
+
+
+struct Result {
+    unsigned long allocations, copies;
+};
+
+
+template <class growth_t>
+Result append_one_by_one(const std::vector<id_t>& ids)
+{
+    Array<growth_t> array;
+    allocations = copies = 0;
+    for (size_t j=0; j<ids.size(); j++) {
+        array.append(ids[j]);
+    }
+    Result r = {allocations, copies};
+    return r;
+}
+
+
+Result append_bulk(const std::vector<id_t>& ids)
+{
+    std::vector<id_t> sorted(ids);
+    std::sort(sorted.begin(), sorted.end());
+
+    Array<GrowGeometric> array;
+    allocations = copies = 0;
+    array.append(&sorted[0], sorted.size());
+    Result r = {allocations, copies};
+    return r;
+}
+
+
+int main()
+{
+    const size_t COUNTS[] = {10, 100, 1000};
+    bool ok = true;
+
+    srand(1);
+    printf("%6s  %22s  %22s  %22s\n", "", "append(id) GrowByOne", "append(id) Geometric", "append(ids) bulk");
+    printf("%6s  %10s %11s  %10s %11s  %10s %11s\n",
+            "n", "allocs", "copies", "allocs", "copies", "allocs", "copies");
+
+    for (size_t c=0; c<sizeof(COUNTS)/sizeof(COUNTS[0]); c++) {
+        std::vector<id_t> ids;
+        while (ids.size() < COUNTS[c]) {
+            const id_t id = ((id_t)rand() << 16) ^ rand();
+            if (std::find(ids.begin(), ids.end(), id) == ids.end()) {
+                ids.push_back(id);
+            }
+        }
+
+        const Result by_one = append_one_by_one<GrowByOne>(ids);
+        const Result geometric = append_one_by_one<GrowGeometric>(ids);
+        const Result bulk = append_bulk(ids);
+
+        printf("%6zu  %10lu %11lu  %10lu %11lu  %10lu %11lu\n", COUNTS[c],
+                by_one.allocations, by_one.copies,
+                geometric.allocations, geometric.copies,
+                bulk.allocations, bulk.copies);
+
+        ok &= COUNTS[c] < 10 || geometric.allocations < by_one.allocations;
+        ok &= bulk.allocations == 1 && bulk.copies <= COUNTS[c];
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,236 @@
+/*
+ * DynamicArray_find_bench.cpp
+ *
+ * Compares DynamicArray::find() with the float interpolation + linear
+ * walk it replaced, on uniform, clustered and sequential IDs, for hits
+ * and misses.  Also checks both agree on every lookup, and times
+ * find(id) through an IdHashIndex.
+ *
+ * Returns non-zero if they disagree or if the new find needs more than
+ * 2*log2(n) + 2 probes for any lookup, as counted by the items' IDs
+ * (see ProbedId).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+#include <tests/FakeArduino.h>
+#include <Logger.h>
+#include "../DynamicArray.h"
+
+static unsigned long probes = 0;
+
+/**
+ * An ID which counts how many times it's compared with < to a target ID.
+ * find() starts each probe with data[probe].id < target_id, so this
+ * counts the probes made by the real find() rather than by a copy of it.
+ * Anything else converts it to a plain id_t.
+ */
+class ProbedId {
+public:
+    ProbedId(const id_t& _id): id(_id) {}
+    operator id_t() const { return id; }
+
+    bool operator<(const id_t& target_id) const
+    {
+        num_probes++;
+        return id < target_id;
+    }
+
+    static unsigned long num_probes;
+
+private:
+    id_t id;
+};
+
+unsigned long ProbedId::num_probes = 0;
+
+
+class Item {
+public:
+    Item(): id(ID_INVALID) {}
+    Item(const id_t& _id): id(_id) {}
+    void print() const {}
+    ProbedId id;
+};
+
+
+class Array : public DynamicArray<Item> {
+public:
+    void print_name() const {}
+
+    /* The original implementation, for reference.  (The original could
+     * read data[n] when the guess overshot; that's clamped here.) */
+    bool old_find(const id_t& target_id, index_t& index) const
+    {
+        if (target_id < min_id) {
+            index = 0;
+            return false;
+        } else if (target_id > max_id) {
+            index = n;
+            return false;
+        }
+        else if (n > 1) {
+            float diff = max_id - min_id;
+            index = ((target_id - min_id) / diff) * (n-1);
+
+            if (index >= n) index = n-1;
+
+            for (; index > 0 && data[index].id > target_id; index--)
+                probes++;
+
+            for (; index < n && data[index].id < target_id; index++)
+                probes++;
+
+            probes++;
+            return index < n && data[index].id == target_id;
+        }
+        else if (n == 1) {
+            index = target_id > data[0].id;
+            return target_id == data[0].id;
+        }
+        return false;
+    }
+};
+
+
+class HashedArray : public DynamicArray<Item, GrowGeometric, IdHashIndex<2048> > {
+public:
+    void print_name() const {}
+};
+
+
+enum Distribution {UNIFORM, CLUSTERED, SEQUENTIAL};
+const char* DISTRIBUTION_NAMES[] = {"uniform", "clustered", "sequential"};
+
+
+static id_t random_id()
+{
+    return ((id_t)rand() << 16) ^ rand();
+}
+
+
+/* Clustered: a few batches of plugs with consecutive-ish IDs,
+ * far apart in the 32-bit ID space, plus one outlier at each end. */
+static std::vector<id_t> make_ids(const Distribution& d, const size_t& count)
+{
+    std::vector<id_t> ids;
+    id_t next = 1000;
+    while (ids.size() < count) {
+        switch (d) {
+        case UNIFORM: ids.push_back(random_id()); break;
+        case SEQUENTIAL: ids.push_back(next++); break;
+        case CLUSTERED:
+            if (ids.size() % (count / 4 + 1) == 0) {
+                next = random_id() >> 2;
+            }
+            next += 1 + rand() % 3;
+            ids.push_back(next);
+            break;
+        }
+    }
+    if (d == CLUSTERED) {
+        ids[0] = 1;
+        ids[1] = 0xFFFFFFF0;
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+
+double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+int main()
+{
+    const size_t COUNTS[] = {100, 1000};
+    const unsigned long LOOKUPS = 200000;
+    bool ok = true;
+
+    srand(1);
+    printf("%-11s %5s  %29s  %29s  %7s  %7s\n", "", "",
+            "------------ old ------------", "------------ new ------------", "", "hashed");
+    printf("%-11s %5s  %9s %9s %9s  %9s %9s %9s  %7s  %7s\n", "ids", "n",
+            "ns/find", "probes", "max", "ns/find", "probes", "max", "bound", "ns/find");
+
+    for (int d=UNIFORM; d<=SEQUENTIAL; d++) {
+        for (size_t c=0; c<sizeof(COUNTS)/sizeof(COUNTS[0]); c++) {
+            const std::vector<id_t> ids = make_ids((Distribution)d, COUNTS[c]);
+            Array array;
+            array.append(&ids[0], ids.size());
+            HashedArray hashed;
+            hashed.append(&ids[0], ids.size());
+            const size_t n = ids.size();
+
+            /* Half real IDs, half real ID + 1 (mostly misses) */
+            std::vector<id_t> targets;
+            for (unsigned long j=0; j<LOOKUPS; j++) {
+                const id_t id = ids[rand() % n];
+                targets.push_back(j % 2 ? id : id + 1);
+            }
+
+            /* Check they agree, and the probe bound */
+            unsigned long max_old = 0, max_new = 0, hits = 0, total_new = 0;
+            for (unsigned long j=0; j<LOOKUPS; j++) {
+                index_t i_old, i_new;
+                probes = 0;
+                const bool found_old = array.old_find(targets[j], i_old);
+                ProbedId::num_probes = 0;
+                const bool found_new = array.find(targets[j], i_new);
+                const unsigned long p = ProbedId::num_probes;
+                if (found_old != found_new || (found_new && i_old != i_new)) {
+                    printf("MISMATCH for %u\n", targets[j]);
+                    return 1;
+                }
+                hits += found_new;
+                max_old = std::max(max_old, probes);
+                total_new += p;
+                max_new = std::max(max_new, p);
+            }
+            const unsigned long bound = 2 * (unsigned long)ceil(log2(n)) + 2;
+            ok &= max_new <= bound;
+
+            /* Time them */
+            index_t index;
+            unsigned long found = 0;
+            probes = 0;
+            double start = now_ns();
+            for (unsigned long j=0; j<LOOKUPS; j++) found += array.old_find(targets[j], index);
+            const double old_ns = (now_ns() - start) / LOOKUPS;
+            const double old_probes = (double)probes / LOOKUPS;
+
+            start = now_ns();
+            for (unsigned long j=0; j<LOOKUPS; j++) found += array.find(targets[j], index);
+            const double new_ns = (now_ns() - start) / LOOKUPS;
+
+            unsigned long found_hashed = 0;
+            start = now_ns();
+            for (unsigned long j=0; j<LOOKUPS; j++) found_hashed += hashed.find(targets[j]);
+            const double hash_ns = (now_ns() - start) / LOOKUPS;
+            if (found_hashed != hits) {
+                printf("hash index found %lu, expected %lu\n", found_hashed, hits);
+                ok = false;
+            }
+
+            if (found != 2 * hits) {
+                printf("unexpected number of hits: %lu\n", found);
+                ok = false;
+            }
+
+            printf("%-11s %5zu  %9.1f %9.1f %9lu  %9.1f %9.1f %9lu  %7lu  %7.1f\n",
+                    DISTRIBUTION_NAMES[d], n, old_ns, old_probes, max_old,
+                    new_ns, (double)total_new / LOOKUPS, max_new, bound, hash_ns);
+        }
+    }
+
+    return ok ? 0 : 1;
+}
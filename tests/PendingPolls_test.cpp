@@ -0,0 +1,80 @@
+/*
+ * PendingPolls_test.cpp
+ *
+ *      Author: Jack Kelly
+ */
+
+#include "../PendingPolls.h"
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE PendingPollsTest
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_CASE(addAndRemove)
+{
+    PendingPolls polls;
+    millis_t sent_at = 0;
+
+    BOOST_CHECK(polls.empty());
+    BOOST_CHECK(polls.add(10, 1000, 30));
+    BOOST_CHECK(!polls.add(10, 1001, 30)); // already pending
+    BOOST_CHECK(polls.add(20, 1005, 30));
+    BOOST_CHECK_EQUAL(polls.get_n(), 2);
+    BOOST_CHECK(polls.contains(10));
+    BOOST_CHECK(!polls.contains(30));
+
+    BOOST_CHECK(!polls.remove(30, sent_at));
+    BOOST_CHECK(polls.remove(10, sent_at));
+    BOOST_CHECK_EQUAL(sent_at, 1000);
+    BOOST_CHECK(!polls.contains(10));
+    BOOST_CHECK(polls.contains(20));
+    BOOST_CHECK(polls.remove(20, sent_at));
+    BOOST_CHECK_EQUAL(sent_at, 1005);
+    BOOST_CHECK(polls.empty());
+}
+
+BOOST_AUTO_TEST_CASE(full)
+{
+    PendingPolls polls;
+
+    for (uint8_t j=0; j<MAX_PENDING_POLLS; j++) {
+        BOOST_CHECK(polls.add(j, 0, 30));
+    }
+    BOOST_CHECK(polls.full());
+    BOOST_CHECK(!polls.add(100, 0, 30));
+}
+
+BOOST_AUTO_TEST_CASE(expire)
+{
+    PendingPolls polls;
+    id_t id;
+
+    polls.add(1, 1000, 30);
+    polls.add(2, 1050, 30);
+
+    BOOST_CHECK(!polls.expire(1099, 100, id));
+    BOOST_CHECK(polls.expire(1100, 100, id));
+    BOOST_CHECK_EQUAL(id, 1);
+    BOOST_CHECK(!polls.expire(1100, 100, id));
+    BOOST_CHECK(polls.expire(1150, 100, id));
+    BOOST_CHECK_EQUAL(id, 2);
+    BOOST_CHECK(polls.empty());
+
+    // millis() roll-over
+    polls.add(3, 0xFFFFFFF0, 30);
+    BOOST_CHECK(!polls.expire(0x00000010, 100, id));
+    BOOST_CHECK(polls.expire(0x00000060, 100, id));
+    BOOST_CHECK_EQUAL(id, 3);
+}
+
+BOOST_AUTO_TEST_CASE(awaitingReply)
+{
+    PendingPolls polls;
+
+    BOOST_CHECK(!polls.awaiting_reply(1000));
+    polls.add(1, 1000, 30);
+    polls.add(2, 1010, 50);
+    BOOST_CHECK(polls.awaiting_reply(1029));
+    BOOST_CHECK(polls.awaiting_reply(1059)); // 2 still within its timeout
+    BOOST_CHECK(!polls.awaiting_reply(1060));
+    BOOST_CHECK_EQUAL(polls.get_n(), 2);     // but both still pending
+}
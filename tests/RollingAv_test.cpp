@@ -1,11 +1,15 @@
 /*
- * DynamicArray_test.cpp
+ * RollingAv_test.cpp
  *
  *  Created on: 16 Oct 2012
  *      Author: jack
  */
 
 #include <iostream>
+#include <algorithm>
+#include <vector>
+#include <stdlib.h>
+#include <time.h>
 
 #include "../RollingAv.h"
 #define BOOST_TEST_DYN_LINK
@@ -38,3 +42,175 @@ BOOST_AUTO_TEST_CASE(rollingAv)
 
 }
 
+
+
+/* Brute-force reference: re-sum the window, as RollingAv used to */
+template <uint8_t WINDOW>
+class ReferenceAv {
+public:
+    ReferenceAv(const uint32_t& initial): index(0)
+    {
+        for (uint8_t j=0; j<WINDOW; j++) samples[j] = initial;
+    }
+    void add_sample(const uint32_t& sample)
+    {
+        samples[index++] = sample;
+        if (index == WINDOW) index = 0;
+    }
+    uint32_t get_av() const
+    {
+        uint64_t acc = 0;
+        for (uint8_t j=0; j<WINDOW; j++) acc += samples[j];
+        return acc / WINDOW;
+    }
+    uint32_t samples[WINDOW];
+    uint8_t index;
+};
+
+
+BOOST_AUTO_TEST_CASE(runningSumMatchesReSum)
+{
+    RollingAverage<16> ra;
+    ReferenceAv<16> ref(SAMPLE_PERIOD);
+
+    srand(1);
+    for (int j=0; j<10000; j++) {
+        const uint16_t sample = 5000 + rand() % 2000;
+        ra.add_sample(sample);
+        ref.add_sample(sample);
+        BOOST_REQUIRE_EQUAL(ra.get_av(), ref.get_av());
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE(noOverflow)
+{
+    // 20 samples of 6000 ms sums to 120,000: too big for uint16_t
+    RollingAverage<20> periods;
+    for (int j=0; j<20; j++) {
+        periods.add_sample(6100);
+    }
+    BOOST_CHECK_EQUAL(periods.get_av(), 6100);
+
+    // Largest possible samples in the largest window
+    RollingAverage<255, uint16_t, uint32_t> big(0);
+    for (int j=0; j<255; j++) {
+        big.add_sample(0xFFFF);
+    }
+    BOOST_CHECK_EQUAL(big.get_av(), 0xFFFF);
+    big.add_sample(0);
+    BOOST_CHECK_EQUAL(big.get_av(), (0xFFFFUL * 254) / 255);
+
+    // Small accumulator is fine for small samples
+    RollingAverage<4, uint8_t, uint16_t> small(0);
+    for (int j=0; j<4; j++) {
+        small.add_sample(250);
+    }
+    BOOST_CHECK_EQUAL(small.get_av(), 250);
+
+    // Signed samples
+    RollingAverage<4, int16_t, int32_t> errors(0);
+    errors.add_sample(-30000);
+    errors.add_sample(-30000);
+    BOOST_CHECK_EQUAL(errors.get_av(), -15000);
+
+    // RollingAverage<20, uint16_t, uint16_t> would fail to compile.
+}
+
+
+BOOST_AUTO_TEST_CASE(robustModes)
+{
+    RollingAverage<5, uint16_t, uint32_t, ROLLING_MEDIAN> median;
+    RollingAverage<5, uint16_t, uint32_t, ROLLING_TRIMMED_MEAN> trimmed;
+
+    BOOST_CHECK_EQUAL(median.get_av(), 6000);
+    BOOST_CHECK_EQUAL(trimmed.get_av(), 6000);
+
+    const uint16_t samples[] = {6010, 12000, 6020, 3000, 6030};
+    for (int j=0; j<5; j++) {
+        median.add_sample(samples[j]);
+        trimmed.add_sample(samples[j]);
+    }
+    // Window is now {6010, 12000, 6020, 3000, 6030}
+    BOOST_CHECK_EQUAL(median.get_av(), 6020);
+    BOOST_CHECK_EQUAL(trimmed.get_av(), 6020);
+
+    // Outliers age out of the window
+    for (int j=0; j<5; j++) {
+        median.add_sample(6100);
+        trimmed.add_sample(6100);
+    }
+    BOOST_CHECK_EQUAL(median.get_av(), 6100);
+    BOOST_CHECK_EQUAL(trimmed.get_av(), 6100);
+
+    // Median of an even window is the mean of the middle two
+    RollingAverage<4, uint16_t, uint32_t, ROLLING_MEDIAN> even(0);
+    even.add_sample(10);
+    even.add_sample(20);
+    even.add_sample(1000);
+    even.add_sample(5);
+    BOOST_CHECK_EQUAL(even.get_av(), 15);
+
+    // Sorted copy stays consistent with duplicates and random data
+    RollingAverage<7, uint16_t, uint32_t, ROLLING_MEDIAN> random_median(0);
+    std::vector<uint16_t> window(7, 0);
+    srand(2);
+    for (int j=0; j<5000; j++) {
+        const uint16_t sample = rand() % 50;
+        window[j % 7] = sample;
+        random_median.add_sample(sample);
+        std::vector<uint16_t> sorted(window);
+        std::sort(sorted.begin(), sorted.end());
+        BOOST_REQUIRE_EQUAL(random_median.get_av(), sorted[3]);
+    }
+}
+
+
+double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/* add_sample() then get_av(), as CcTx::update() does.
+ * @return ns per sample */
+template <class av_t>
+double time_av(av_t& av, const int& iterations, uint32_t& checksum)
+{
+    const double start = now_ns();
+    for (int j=0; j<iterations; j++) {
+        av.add_sample(5500 + (j * 37) % 1000);
+        checksum += av.get_av();
+    }
+    return (now_ns() - start) / iterations;
+}
+
+
+/* Prints timings only: the tests are built at -O0 and may share the
+ * machine, so they mustn't fail on wall-clock time. */
+BOOST_AUTO_TEST_CASE(benchmark)
+{
+    const int ITERATIONS = 1000000;
+    uint32_t checksum = 0;
+
+    ReferenceAv<5> ref5(SAMPLE_PERIOD);
+    ReferenceAv<64> ref64(SAMPLE_PERIOD);
+    RollingAverage<5> mean5;
+    RollingAverage<64> mean64;
+    RollingAverage<5, uint16_t, uint32_t, ROLLING_MEDIAN> median5;
+    RollingAverage<5, uint16_t, uint32_t, ROLLING_TRIMMED_MEAN> trimmed5;
+
+    const double ref5_ns = time_av(ref5, ITERATIONS, checksum);
+    const double ref64_ns = time_av(ref64, ITERATIONS, checksum);
+    const double mean5_ns = time_av(mean5, ITERATIONS, checksum);
+    const double mean64_ns = time_av(mean64, ITERATIONS, checksum);
+    const double median5_ns = time_av(median5, ITERATIONS, checksum);
+    const double trimmed5_ns = time_av(trimmed5, ITERATIONS, checksum);
+
+    std::cout << "ns per add_sample() + get_av() (checksum " << checksum << "):" << std::endl
+              << "  re-sum window 5: " << ref5_ns << ", window 64: " << ref64_ns << std::endl
+              << "  running sum  5: " << mean5_ns << ", window 64: " << mean64_ns << std::endl
+              << "  median 5: " << median5_ns << ", trimmed mean 5: " << trimmed5_ns << std::endl;
+}
@@ -0,0 +1,212 @@
+/*
+ * RxPacketFromSensor_bench.cpp
+ *
+ * Micro-benchmark comparing the table-driven
+ * RxPacketFromSensor::de_manchesterise() with the bit-pair-at-a-time
+ * loop it replaced.  Also checks that both produce identical output and
+ * health for every possible pair of source bytes.
+ *
+ * Also times the work done in the RFM12b ISR as each packet arrives and,
+ * with LAZY_DECODE, the decoding which that defers to the main loop.
+ *
+ * Returns non-zero if the outputs differ or if the table is not faster.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <tests/FakeArduino.h>
+#include "../RxPacketFromSensor.h"
+
+typedef RxPacketFromSensor::Health Health;
+
+/* The original implementation, for reference. */
+Health de_manchesterise_loop(volatile byte* packet, const index_t length)
+{
+    const byte ONE = 0b10000000; // 1 in Manchester-speak is 10
+    const byte ZERO = 0b01000000; // 0 in Manchester-speak is 01
+    const byte MASK = 0b11000000; // 2-bit window to select current pit pair
+
+    byte bit, src_byte, src_byte_masked, output;
+    index_t src_byte_i, src_byte_offset, bit_pair;
+    bool success = true;
+
+    for (src_byte_i=0; src_byte_i<length; src_byte_i+=2) {
+        output = 0;
+        for (src_byte_offset=0; src_byte_offset<2; src_byte_offset++) {
+            src_byte = packet[src_byte_i+src_byte_offset];
+            for (bit_pair=0; bit_pair<8; bit_pair+=2) {
+                src_byte_masked = src_byte & (MASK >> bit_pair);
+                if (src_byte_masked == ONE >> bit_pair) {
+                    bit = 1;
+                } else if (src_byte_masked == ZERO >> bit_pair) {
+                    bit = 0;
+                } else {
+                    success = false;
+                    bit = 0;
+                }
+                output <<= 1;
+                output |= bit;
+            }
+        }
+        packet[src_byte_i / 2] = output;
+    }
+
+    return success ? RxPacketFromSensor::OK : RxPacketFromSensor::BAD;
+}
+
+
+/* Vectors from RxPacketFromSensor_test.cpp */
+const index_t LENGTH = 16;
+const index_t NUM_VECTORS = 6;
+const byte VECTORS[NUM_VECTORS][LENGTH] = {
+        {0x55, 0xA6, 0x6A, 0xAA, 0x95, 0x55, 0x9A, 0x65,
+         0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55},
+        {0x55, 0xA6, 0x6A, 0xAA, 0x95, 0x55, 0x55, 0x55,
+         0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55},
+        {0x55, 0xAA, 0x65, 0x96, 0x95, 0x55, 0x55, 0x55,
+         0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55},
+        {0x95, 0x96, 0x6A, 0x96, 0x95, 0x55, 0x55, 0x55,
+         0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55},
+        {0x55, 0x55, 0x65, 0xA6, 0x95, 0x55, 0x55, 0x55,
+         0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55},
+        {0x57, 0x55, 0x65, 0xA6, 0x95, 0x55, 0x55, 0x55,   // illegal 11 pair
+         0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55}};
+
+const unsigned long ITERATIONS = 2000000;
+
+typedef Health (*decoder_t)(volatile byte*, const index_t);
+
+
+double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/* @return ns per packet */
+double time_decoder(decoder_t decoder)
+{
+    volatile byte buffer[LENGTH];
+    unsigned long bad = 0;
+
+    const double start = now_ns();
+    for (unsigned long it=0; it<ITERATIONS; it++) {
+        const byte* src = VECTORS[it % NUM_VECTORS];
+        for (index_t j=0; j<LENGTH; j++) {
+            buffer[j] = src[j];
+        }
+        bad += decoder(buffer, LENGTH) == RxPacketFromSensor::BAD;
+    }
+    const double elapsed = now_ns() - start;
+
+    if (bad != ITERATIONS / NUM_VECTORS) {
+        printf("unexpected number of BAD packets: %lu\n", bad);
+    }
+    return elapsed / ITERATIONS;
+}
+
+
+/* Check every possible pair of source bytes decodes identically */
+bool check_equivalence()
+{
+    volatile byte a[2], b[2];
+
+    for (unsigned int hi=0; hi<256; hi++) {
+        for (unsigned int lo=0; lo<256; lo++) {
+            a[0] = b[0] = hi;
+            a[1] = b[1] = lo;
+            const Health health_loop = de_manchesterise_loop(a, 2);
+            const Health health_table = RxPacketFromSensor::de_manchesterise(b, 2);
+            if (health_loop != health_table || a[0] != b[0]) {
+                printf("MISMATCH for 0x%02X 0x%02X: loop=0x%02X/%d table=0x%02X/%d\n",
+                        hi, lo, a[0], health_loop, b[0], health_table);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+/* Feed packets in a byte at a time, as the ISR does, then read them
+ * back as Manager does.
+ * @param isr_ns set to ns per packet spent in append()
+ * @param decode_ns set to ns per packet spent in decode()
+ * @return false if a complete packet wasn't queued for the main loop */
+bool time_isr(double& isr_ns, double& decode_ns)
+{
+    RxPacketFromSensor rx_packet;
+    RxPacketFromSensor* popped = NULL;
+    double isr = 0, decode = 0, overhead = 0;
+    unsigned long ok = 0;
+
+    /* Each packet is timed on its own so subtract the cost of now_ns() */
+    for (unsigned long it=0; it<ITERATIONS; it++) {
+        const double start = now_ns();
+        overhead += now_ns() - start;
+    }
+
+    for (unsigned long it=0; it<ITERATIONS; it++) {
+        const byte* src = VECTORS[it % NUM_VECTORS];
+        rx_packet.reset();
+
+        double start = now_ns();
+        for (index_t j=0; j<LENGTH; j++) {
+            rx_packet.append(src[j]);
+        }
+        isr += now_ns() - start;
+
+        if (!RxPacketFromSensor::ready_packets.pop(popped)) {
+            printf("packet %lu wasn't queued\n", it);
+            return false;
+        }
+        start = now_ns();
+        popped->decode();
+        decode += now_ns() - start;
+        ok += popped->is_ok();
+    }
+
+    if (ok != ITERATIONS - ITERATIONS / NUM_VECTORS) {
+        printf("unexpected number of OK packets: %lu\n", ok);
+    }
+    isr_ns = (isr - overhead) / ITERATIONS;
+    decode_ns = (decode - overhead) / ITERATIONS;
+    return true;
+}
+
+
+int main()
+{
+    if (!check_equivalence()) {
+        return 1;
+    }
+    printf("Table and loop agree for all 65536 source byte pairs.\n");
+
+    /* Run each twice and keep the best to reduce noise */
+    double loop_ns = time_decoder(de_manchesterise_loop);
+    double table_ns = time_decoder(RxPacketFromSensor::de_manchesterise);
+    const double loop_ns2 = time_decoder(de_manchesterise_loop);
+    const double table_ns2 = time_decoder(RxPacketFromSensor::de_manchesterise);
+    if (loop_ns2 < loop_ns) loop_ns = loop_ns2;
+    if (table_ns2 < table_ns) table_ns = table_ns2;
+
+    printf("de_manchesterise 16 byte packet: loop %.1f ns, table %.1f ns (%.1fx faster)\n",
+            loop_ns, table_ns, loop_ns / table_ns);
+
+    double isr_ns, decode_ns;
+    if (!time_isr(isr_ns, decode_ns)) {
+        return 1;
+    }
+#ifdef LAZY_DECODE
+    printf("16 byte packet, LAZY_DECODE: ISR %.1f ns, decode in main loop %.1f ns\n",
+            isr_ns, decode_ns);
+#else
+    printf("16 byte packet, decode in ISR: ISR %.1f ns, main loop %.1f ns\n",
+            isr_ns, decode_ns);
+#endif
+
+    return table_ns < loop_ns ? 0 : 1;
+}
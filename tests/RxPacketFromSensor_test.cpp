@@ -18,6 +18,7 @@ void append_array(RxPacketFromSensor& rx_packet,
     for (index_t i=0; i<length; i++){
         rx_packet.append(data[i]);
     }
+    rx_packet.decode(); // as Manager does once it pops the packet
 }
 
 BOOST_AUTO_TEST_CASE(txPacket1)
@@ -177,3 +178,95 @@ BOOST_AUTO_TEST_CASE(demanchesteriseFail)
 
     BOOST_CHECK(!rx_packet.is_ok());
 }
+
+
+#ifdef LAZY_DECODE
+BOOST_AUTO_TEST_CASE(lazyDecode)
+{
+    RxPacketFromSensor rx_packet;
+
+    const index_t LENGTH = 16;
+    const byte data[] = {
+            0x55, 0xA6, 0x6A, 0xAA, 0x95, 0x55, 0x9A, 0x65,
+            0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55  };
+
+    // The ISR leaves the raw bytes alone...
+    for (index_t i=0; i<LENGTH; i++) {
+        rx_packet.append(data[i]);
+    }
+    BOOST_CHECK(rx_packet.done());
+    BOOST_CHECK(!rx_packet.is_ok());
+    BOOST_CHECK_EQUAL(rx_packet.get_length(), LENGTH);
+    BOOST_CHECK_EQUAL(rx_packet.get_packet()[1], data[1]);
+
+    // ...until the main loop decodes them, once
+    rx_packet.decode();
+    BOOST_CHECK_EQUAL(rx_packet.get_length(), LENGTH / 2);
+    BOOST_CHECK(rx_packet.is_ok());
+    BOOST_CHECK_EQUAL(rx_packet.get_id(), 3455);
+    rx_packet.decode();
+    BOOST_CHECK_EQUAL(rx_packet.get_id(), 3455);
+    BOOST_CHECK_EQUAL(rx_packet.get_watts()[0], 180);
+    BOOST_CHECK_EQUAL(rx_packet.get_length(), LENGTH / 2);
+
+    // Re-used packets are decoded afresh
+    rx_packet.reset();
+    BOOST_CHECK(!rx_packet.is_ok());
+    const byte trx_data[] = {0x52, 0x00, 0x00, 0x09, 0x79,
+                             0x53, 0x00, 0x00, 0x00, 0x00, 0x53, 0x7A};
+    append_array(rx_packet, trx_data, 12);
+    BOOST_CHECK(rx_packet.is_ok());
+    BOOST_CHECK_EQUAL(rx_packet.get_id(), 2425);
+}
+#endif // LAZY_DECODE
+
+
+BOOST_AUTO_TEST_CASE(readyPackets)
+{
+    // Forget packets pushed by the tests above
+    RxPacketFromSensor* packet;
+    while (RxPacketFromSensor::ready_packets.pop(packet)) {}
+    BOOST_CHECK(RxPacketFromSensor::ready_packets.empty());
+
+    const index_t LENGTH = 16;
+    const byte data[] = {
+            0x55, 0xA6, 0x6A, 0xAA, 0x95, 0x55, 0x9A, 0x65,
+            0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55  };
+    const byte broken[] = {
+            0x57, 0x55, 0x65, 0xA6, 0x95, 0x55, 0x55, 0x55,
+            0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55  };
+
+    // Packets are queued once done, broken or not, in the order they finish
+    RxPacketFromSensor buffer[PACKET_BUF_LENGTH];
+    append_array(buffer[1], data, LENGTH - 1);
+    BOOST_CHECK(RxPacketFromSensor::ready_packets.empty());
+    append_array(buffer[2], broken, LENGTH);
+    buffer[1].append(data[LENGTH - 1]);
+    BOOST_CHECK_EQUAL(RxPacketFromSensor::ready_packets.size(), 2);
+    BOOST_REQUIRE(RxPacketFromSensor::ready_packets.pop(packet));
+    BOOST_CHECK_EQUAL(packet, &buffer[2]);
+    BOOST_REQUIRE(RxPacketFromSensor::ready_packets.pop(packet));
+    BOOST_CHECK_EQUAL(packet, &buffer[1]);
+    BOOST_CHECK(!RxPacketFromSensor::ready_packets.pop(packet));
+
+    // Counts each time every packet in the buffer is waiting
+    const uint16_t num_full = RxPacketFromSensor::ready_packets.get_num_full();
+    for (index_t i=0; i<PACKET_BUF_LENGTH; i++) {
+        buffer[i].reset();
+        append_array(buffer[i], data, LENGTH);
+    }
+    BOOST_CHECK_EQUAL(RxPacketFromSensor::ready_packets.size(), PACKET_BUF_LENGTH);
+    BOOST_CHECK_EQUAL(RxPacketFromSensor::ready_packets.get_num_full(), num_full + 1);
+
+    // A packet pushed twice without being popped is dropped
+    const uint16_t num_dropped = RxPacketFromSensor::ready_packets.get_num_dropped();
+    buffer[0].reset();
+    append_array(buffer[0], data, LENGTH);
+    BOOST_CHECK_EQUAL(RxPacketFromSensor::ready_packets.get_num_dropped(), num_dropped + 1);
+
+    for (index_t i=0; i<PACKET_BUF_LENGTH; i++) {
+        BOOST_REQUIRE(RxPacketFromSensor::ready_packets.pop(packet));
+        BOOST_CHECK_EQUAL(packet, &buffer[i]);
+    }
+    BOOST_CHECK(RxPacketFromSensor::ready_packets.empty());
+}
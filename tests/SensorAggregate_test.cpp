@@ -0,0 +1,58 @@
+/*
+ * SensorAggregate_test.cpp
+ *
+ *      Author: Jack Kelly
+ */
+
+#include "../SensorAggregate.h"
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE SensorAggregateTest
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_CASE(minMeanMax)
+{
+    SensorAggregate aggregate;
+    BOOST_CHECK_EQUAL(aggregate.n, 0);
+    BOOST_CHECK_EQUAL(aggregate.get_mean(), 0);
+
+    aggregate.add(100);
+    aggregate.add(300);
+    aggregate.add(WATTS_INVALID); // ignored
+    aggregate.add(200);
+    BOOST_CHECK_EQUAL(aggregate.n, 3);
+    BOOST_CHECK_EQUAL(aggregate.min, 100);
+    BOOST_CHECK_EQUAL(aggregate.max, 300);
+    BOOST_CHECK_EQUAL(aggregate.get_mean(), 200);
+
+    aggregate.reset();
+    aggregate.add(0);
+    BOOST_CHECK_EQUAL(aggregate.n, 1);
+    BOOST_CHECK_EQUAL(aggregate.min, 0);
+    BOOST_CHECK_EQUAL(aggregate.max, 0);
+}
+
+BOOST_AUTO_TEST_CASE(energy)
+{
+    SensorAggregate aggregate;
+    aggregate.add(1000);
+    BOOST_CHECK_EQUAL(aggregate.get_mwh(3600), 1000000); // 1 kWh
+    BOOST_CHECK_EQUAL(aggregate.get_mwh(60), 16660);     // 16.67 Wh, to 10 mWh
+
+    // Largest reading over the longest window mustn't overflow
+    aggregate.reset();
+    aggregate.add(WATTS_INVALID - 1);
+    BOOST_CHECK_EQUAL(aggregate.get_mwh(0xFFFF),
+            (uint32_t)((uint64_t)(WATTS_INVALID - 1) * 0xFFFF / 36 * 10));
+}
+
+BOOST_AUTO_TEST_CASE(saturates)
+{
+    /* A day of TRX readings every 6 seconds is 14400; make sure a
+     * window which is far too long doesn't wrap n. */
+    SensorAggregate aggregate;
+    for (uint32_t j=0; j<0x10010; j++) {
+        aggregate.add(WATTS_INVALID - 1);
+    }
+    BOOST_CHECK_EQUAL(aggregate.n, 0xFFFF);
+    BOOST_CHECK_EQUAL(aggregate.get_mean(), WATTS_INVALID - 1);
+}
@@ -0,0 +1,65 @@
+/*
+ * SerialArgParser_test.cpp
+ *
+ *      Author: Jack Kelly
+ */
+
+#include <iostream>
+#include <string>
+
+#include "../SerialArgParser.h"
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE SerialArgParserTest
+#include <boost/test/unit_test.hpp>
+
+/* Feed str one char at a time.  Returns the value if the argument
+ * completed on the last char of str, else 0xDEADBEEF. */
+uint32_t feed_string(SerialArgParser& parser, const std::string& str)
+{
+    for (size_t i=0; i<str.size(); i++) {
+        if (parser.feed(str[i])) {
+            BOOST_CHECK_EQUAL(i, str.size()-1);
+            return parser.get_value();
+        }
+    }
+    return 0xDEADBEEF;
+}
+
+BOOST_AUTO_TEST_CASE(validNumbers)
+{
+    SerialArgParser parser;
+
+    BOOST_CHECK_EQUAL(feed_string(parser, "123\r"), 123);
+    parser.reset();
+    BOOST_CHECK_EQUAL(feed_string(parser, "0\n"), 0);
+    parser.reset();
+    BOOST_CHECK_EQUAL(feed_string(parser, "4294967294\r"), 4294967294UL);
+}
+
+BOOST_AUTO_TEST_CASE(incomplete)
+{
+    SerialArgParser parser;
+
+    // No terminator yet so nothing to report
+    BOOST_CHECK_EQUAL(feed_string(parser, "12"), 0xDEADBEEF);
+    BOOST_CHECK_EQUAL(feed_string(parser, "34\r"), 1234);
+}
+
+BOOST_AUTO_TEST_CASE(invalid)
+{
+    SerialArgParser parser;
+
+    BOOST_CHECK_EQUAL(feed_string(parser, "\r"), UINT32_INVALID);
+    parser.reset();
+    BOOST_CHECK_EQUAL(feed_string(parser, "12a3\r"), UINT32_INVALID);
+    parser.reset();
+    BOOST_CHECK_EQUAL(feed_string(parser, "-1\r"), UINT32_INVALID);
+    parser.reset();
+    BOOST_CHECK_EQUAL(feed_string(parser, "4294967296\r"), UINT32_INVALID); // overflow
+    parser.reset();
+    BOOST_CHECK_EQUAL(feed_string(parser, "99999999999\r"), UINT32_INVALID);
+
+    // reset() clears the error
+    parser.reset();
+    BOOST_CHECK_EQUAL(feed_string(parser, "5\r"), 5);
+}
@@ -0,0 +1,92 @@
+/*
+ * SerialTx_test.cpp
+ *
+ *      Author: Jack Kelly
+ *
+ * FakeSerial prints to std::cout, which these tests capture.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "../SerialTx.h"
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE SerialTxTest
+#include <boost/test/unit_test.hpp>
+
+/* Redirects std::cout for as long as it exists */
+struct CaptureSerial {
+    CaptureSerial() : old(std::cout.rdbuf(out.rdbuf())) {}
+    ~CaptureSerial() { std::cout.rdbuf(old); }
+    std::string str() { std::string s = out.str(); out.str(""); return s; }
+    std::ostringstream out;
+    std::streambuf* old;
+};
+
+BOOST_AUTO_TEST_CASE(printAndDrain)
+{
+    CaptureSerial serial;
+    SerialTx tx;
+
+    tx.print("id ");
+    tx.print(0u);
+    tx.print(' ');
+    tx.print(4294967295u);
+    tx.print(", ");
+    tx.println((uint16_t)180);
+
+    BOOST_CHECK_EQUAL(serial.str(), ""); // nothing sent until drain()
+    BOOST_CHECK(!tx.empty());
+    tx.drain();
+    BOOST_CHECK_EQUAL(serial.str(), "id 0 4294967295, 180\r\n");
+    BOOST_CHECK(tx.empty());
+    BOOST_CHECK_EQUAL(tx.get_num_blocked(), 0);
+    BOOST_CHECK_EQUAL(tx.get_high_water(), 22);
+}
+
+BOOST_AUTO_TEST_CASE(burstsWaitForRoom)
+{
+    CaptureSerial serial;
+    SerialTx tx;
+    const std::string reading(SERIAL_TX_BUFFER_LENGTH / 2 - 1, 'a');
+    std::string expected;
+
+    // Two readings fit.  The third waits for the oldest bytes to be
+    // sent but none of it is lost.
+    for (int i=0; i<3; i++) {
+        tx.print(reading.c_str());
+        tx.print(i + 0u);
+        expected += reading + char('0' + i);
+    }
+    BOOST_CHECK_EQUAL(tx.get_num_blocked(), reading.size() + 1);
+    BOOST_CHECK_EQUAL(tx.get_num_deferred(), reading.size() + 1);
+    BOOST_CHECK_EQUAL(tx.get_high_water(), SERIAL_TX_BUFFER_LENGTH);
+    BOOST_CHECK_EQUAL(serial.str(), expected.substr(0, reading.size() + 1));
+
+    // Bytes already counted as blocked aren't counted again by drain()
+    tx.drain();
+    BOOST_CHECK(tx.empty());
+    BOOST_CHECK_EQUAL(tx.get_num_deferred(), reading.size() + 1);
+    BOOST_CHECK_EQUAL(serial.str(), expected.substr(reading.size() + 1));
+}
+
+BOOST_AUTO_TEST_CASE(flushSendsEverything)
+{
+    CaptureSerial serial;
+    SerialTx tx;
+    std::string expected;
+
+    // Once the ring is full the oldest bytes are sent to make room
+    for (int i=0; i<SERIAL_TX_BUFFER_LENGTH + 10; i++) {
+        const char c = 'a' + i % 26;
+        tx.write(c);
+        expected += c;
+    }
+    BOOST_CHECK_EQUAL(serial.str(), expected.substr(0, 10));
+    BOOST_CHECK_EQUAL(tx.get_num_blocked(), 10);
+
+    tx.flush();
+    BOOST_CHECK(tx.empty());
+    BOOST_CHECK_EQUAL(serial.str(), expected.substr(10));
+}
@@ -0,0 +1,193 @@
+/*
+ * SpscQueue_test.cpp
+ *
+ *      Author: Jack Kelly
+ *
+ * The stress tests run the producer in a second thread, standing in for
+ * the RFM12b interrupt, while this thread consumes.  Spinning threads
+ * yield so the tests finish on a single core too.
+ */
+
+#include <atomic>
+#include <thread>
+#include "../SpscQueue.h"
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE SpscQueueTest
+#include <boost/test/unit_test.hpp>
+
+const uint8_t LENGTH = 5;
+
+BOOST_AUTO_TEST_CASE(fifo)
+{
+    SpscQueue<uint16_t, LENGTH> queue;
+    uint16_t item;
+
+    BOOST_CHECK(queue.empty());
+    BOOST_CHECK(!queue.pop(item));
+
+    // Wraps around several times
+    for (uint16_t j=0; j<100; j++) {
+        BOOST_REQUIRE(queue.push(j));
+        BOOST_REQUIRE(queue.push(j + 1000));
+        BOOST_REQUIRE(queue.pop(item));
+        BOOST_CHECK_EQUAL(item, j);
+        BOOST_REQUIRE(queue.pop(item));
+        BOOST_CHECK_EQUAL(item, j + 1000);
+    }
+    BOOST_CHECK(queue.empty());
+    BOOST_CHECK_EQUAL(queue.get_num_enqueued(), 200);
+    BOOST_CHECK_EQUAL(queue.get_high_water(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(counters)
+{
+    SpscQueue<uint16_t, LENGTH> queue;
+    uint16_t item;
+
+    for (uint16_t j=0; j<LENGTH; j++) {
+        BOOST_CHECK(queue.push(j));
+    }
+    BOOST_CHECK_EQUAL(queue.size(), LENGTH);
+    BOOST_CHECK_EQUAL(queue.get_num_full(), 1);
+
+    BOOST_CHECK(!queue.push(99));
+    BOOST_CHECK(!queue.push(99));
+    BOOST_CHECK_EQUAL(queue.get_num_dropped(), 2);
+    BOOST_CHECK_EQUAL(queue.get_num_enqueued(), LENGTH);
+    BOOST_CHECK_EQUAL(queue.get_high_water(), LENGTH);
+
+    // Dropped items never appear
+    for (uint16_t j=0; j<LENGTH; j++) {
+        BOOST_REQUIRE(queue.pop(item));
+        BOOST_CHECK_EQUAL(item, j);
+    }
+    BOOST_CHECK(!queue.pop(item));
+    BOOST_CHECK_EQUAL(queue.get_high_water(), LENGTH);
+}
+
+
+/* Large enough that a torn read would show up as a bad checksum */
+struct Item {
+    uint32_t seq;
+    uint32_t check;
+    uint8_t  payload[16];
+};
+
+Item make_item(const uint32_t& seq)
+{
+    Item item;
+    item.seq = seq;
+    item.check = ~seq;
+    for (uint8_t j=0; j<sizeof(item.payload); j++) {
+        item.payload[j] = seq + j;
+    }
+    return item;
+}
+
+bool is_intact(const Item& item)
+{
+    if (item.check != ~item.seq) return false;
+    for (uint8_t j=0; j<sizeof(item.payload); j++) {
+        if (item.payload[j] != (uint8_t)(item.seq + j)) return false;
+    }
+    return true;
+}
+
+
+BOOST_AUTO_TEST_CASE(stressWithDrops)
+{
+    /* Like the ISR, the producer never waits: if the queue is full the
+     * item is dropped. */
+    const uint32_t N = 2000000;
+    SpscQueue<Item, LENGTH> queue;
+    uint32_t producer_drops = 0;
+    std::atomic<bool> finished(false);
+
+    std::thread isr([&]() {
+        for (uint32_t seq=1; seq<=N; seq++) {
+            if (!queue.push(make_item(seq))) {
+                producer_drops++;
+                std::this_thread::yield(); // let the consumer catch up
+            }
+        }
+        finished = true;
+    });
+
+    uint32_t received = 0, last_seq = 0;
+    bool in_order = true, intact = true;
+    Item item;
+    for (;;) {
+        const bool was_finished = finished;
+        if (queue.pop(item)) {
+            received++;
+            in_order &= item.seq > last_seq;
+            intact &= is_intact(item);
+            last_seq = item.seq;
+        } else if (was_finished) {
+            break; // nothing more can arrive
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    isr.join();
+
+    BOOST_CHECK(in_order);
+    BOOST_CHECK(intact);
+    BOOST_CHECK_EQUAL(received + producer_drops, N);
+    BOOST_CHECK_EQUAL(queue.get_num_enqueued(), received);
+    BOOST_CHECK_EQUAL(queue.get_num_dropped(), (uint16_t)producer_drops);
+    BOOST_CHECK(queue.get_high_water() <= LENGTH);
+    BOOST_TEST_MESSAGE("received " << received << ", dropped " << producer_drops
+            << ", high water " << (int)queue.get_high_water());
+}
+
+
+BOOST_AUTO_TEST_CASE(stressOwnershipHandOff)
+{
+    /* Hand slots of a shared buffer back and forth, as Manager and the
+     * ISR do with RxPacketFromSensors: the ISR fills a free slot and
+     * pushes it onto ready; the main loop pops it, checks it and hands it
+     * back on free.  Neither side touches a slot it doesn't own, so every
+     * slot must arrive intact and nothing may be dropped. */
+    const uint32_t N = 1000000;
+    Item buffer[LENGTH];
+    SpscQueue<Item*, LENGTH> ready, free_slots;
+    for (uint8_t j=0; j<LENGTH; j++) {
+        free_slots.push(&buffer[j]);
+    }
+
+    std::thread isr([&]() {
+        Item* slot;
+        for (uint32_t seq=1; seq<=N; seq++) {
+            while (!free_slots.pop(slot)) { // wait for the main loop
+                std::this_thread::yield();
+            }
+            *slot = make_item(seq);
+            ready.push(slot);
+        }
+    });
+
+    uint32_t last_seq = 0;
+    bool in_order = true, intact = true;
+    Item* slot;
+    while (last_seq < N) {
+        if (ready.pop(slot)) {
+            in_order &= slot->seq == last_seq + 1;
+            intact &= is_intact(*slot);
+            last_seq = slot->seq;
+            slot->seq = 0; // if the ISR were still writing this slot
+            slot->check = 0; // it would now fail is_intact()
+            free_slots.push(slot);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    isr.join();
+
+    BOOST_CHECK(in_order);
+    BOOST_CHECK(intact);
+    BOOST_CHECK_EQUAL(ready.get_num_enqueued(), N);
+    BOOST_CHECK_EQUAL(ready.get_num_dropped(), 0);
+    BOOST_CHECK_EQUAL(free_slots.get_num_dropped(), 0);
+    BOOST_CHECK(ready.get_high_water() <= LENGTH);
+}
@@ -0,0 +1,217 @@
+/*
+ * WarmStart_test.cpp
+ *
+ *      Author: Jack Kelly
+ */
+
+#include <chrono>
+#include "../WarmStart.h"
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE WarmStartTest
+#include <boost/test/unit_test.hpp>
+
+typedef RamStorage<1024> FakeEeprom; /* as on the ATmega328 */
+
+const index_t NUM_TXS = 16, NUM_TRXS = 200;
+
+/* TX k has been heard enough to learn a period of 6000 + k ms */
+void make_arrays(CcTxArray& cc_txs, CcTrxArray& cc_trxs)
+{
+    for (index_t k=0; k<NUM_TXS; k++) {
+        BOOST_REQUIRE(cc_txs.append(100 + k*7));
+    }
+    for (index_t k=0; k<NUM_TXS; k++) {
+        for (millis_t t=0; t<20; t++) {
+            cc_txs[k].update(1000 + t * (6000 + k) + (t % 3));
+        }
+    }
+    for (index_t k=0; k<NUM_TRXS; k++) {
+        BOOST_REQUIRE(cc_trxs.append(0x10000000 + k*104729));
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE(roundTrip)
+{
+    Logger::log_threshold = FATAL;
+    FakeEeprom eeprom;
+    CcTxArray cc_txs;
+    CcTrxArray cc_trxs;
+    make_arrays(cc_txs, cc_trxs);
+
+    WarmStart before(eeprom);
+    BOOST_REQUIRE(before.save(cc_txs, cc_trxs));
+    BOOST_CHECK_EQUAL(before.get_num_saves(), 1);
+    BOOST_CHECK_EQUAL(WarmStart::get_image_size(cc_txs, cc_trxs), 6 + 4 + 16*8 + 200*4);
+
+    // Power cycle
+    WarmStart after(eeprom);
+    CcTxArray restored_txs;
+    CcTrxArray restored_trxs;
+    BOOST_REQUIRE(after.restore(restored_txs, restored_trxs, 0));
+
+    BOOST_REQUIRE_EQUAL(restored_txs.get_n(), NUM_TXS);
+    for (index_t k=0; k<NUM_TXS; k++) {
+        BOOST_CHECK_EQUAL(restored_txs[k].id, cc_txs[k].id);
+        BOOST_CHECK_EQUAL(restored_txs[k].get_period_x256(), cc_txs[k].get_period_x256());
+        BOOST_CHECK_EQUAL(restored_txs[k].get_period(), 6000 + k);
+        BOOST_CHECK_EQUAL(restored_txs[k].get_eta_error_sd(), cc_txs[k].get_eta_error_sd());
+    }
+    BOOST_REQUIRE_EQUAL(restored_trxs.get_n(), NUM_TRXS);
+    for (index_t k=0; k<NUM_TRXS; k++) {
+        BOOST_CHECK_EQUAL(restored_trxs[k].id, cc_trxs[k].id);
+    }
+    BOOST_CHECK(restored_trxs.find(cc_trxs[123].id));
+}
+
+
+BOOST_AUTO_TEST_CASE(badImage)
+{
+    FakeEeprom eeprom;
+    CcTxArray cc_txs;
+    CcTrxArray cc_trxs;
+    make_arrays(cc_txs, cc_trxs);
+
+    CcTxArray restored_txs;
+    CcTrxArray restored_trxs;
+    WarmStart warm_start(eeprom);
+
+    // Never saved
+    BOOST_CHECK(!warm_start.restore(restored_txs, restored_trxs, 0));
+
+    // One flipped bit in a TRX ID
+    BOOST_REQUIRE(warm_start.save(cc_txs, cc_trxs));
+    eeprom.bytes[500] ^= 0x04;
+    BOOST_CHECK(!warm_start.restore(restored_txs, restored_trxs, 0));
+    BOOST_CHECK_EQUAL(restored_txs.get_n(), 0);
+    BOOST_CHECK_EQUAL(restored_trxs.get_n(), 0);
+    eeprom.bytes[500] ^= 0x04;
+    BOOST_CHECK(warm_start.restore(restored_txs, restored_trxs, 0));
+
+    // Too many sensors to fit: nothing is written
+    const uint32_t writes = eeprom.num_writes;
+    for (index_t k=0; k<60; k++) {
+        cc_trxs.append(k + 1);
+    }
+    BOOST_CHECK(!warm_start.save(cc_txs, cc_trxs));
+    BOOST_CHECK_EQUAL(eeprom.num_writes, writes);
+}
+
+
+BOOST_AUTO_TEST_CASE(coalescing)
+{
+    FakeEeprom eeprom;
+    CcTxArray cc_txs;
+    CcTrxArray cc_trxs;
+    WarmStart warm_start(eeprom);
+    millis_t now = 0;
+
+    // The host pairs a sensor every 100 ms.  Nothing is saved until
+    // they've stopped coming for WARM_START_SAVE_DELAY.
+    for (index_t k=0; k<NUM_TRXS; k++) {
+        cc_trxs.append(k + 1);
+        warm_start.ids_changed(now);
+        for (millis_t t=0; t<100; t++, now++) {
+            warm_start.run(cc_txs, cc_trxs, now);
+        }
+    }
+    BOOST_CHECK_EQUAL(eeprom.num_writes, 0);
+
+    const millis_t last_change = now - 100;
+    for (; now < last_change + WARM_START_SAVE_DELAY + 1000; now++) {
+        warm_start.run(cc_txs, cc_trxs, now);
+    }
+    BOOST_CHECK_EQUAL(warm_start.get_num_saves(), 1);
+    const uint32_t image_size = WarmStart::get_image_size(cc_txs, cc_trxs);
+    BOOST_CHECK(eeprom.num_writes <= image_size);
+
+    // The save was spread over many calls to run(), without missing a byte
+    CcTxArray restored_txs;
+    CcTrxArray restored_trxs;
+    BOOST_REQUIRE(WarmStart(eeprom).restore(restored_txs, restored_trxs, 0));
+    BOOST_CHECK_EQUAL(restored_trxs.get_n(), NUM_TRXS);
+
+    // Nothing has changed by the time the timing is saved so nothing is written
+    const uint32_t writes = eeprom.num_writes;
+    for (; now < last_change + WARM_START_TIMING_INTERVAL * 2; now += 10) {
+        warm_start.run(cc_txs, cc_trxs, now);
+    }
+    BOOST_CHECK(warm_start.get_num_saves() >= 2);
+    BOOST_CHECK_EQUAL(eeprom.num_writes, writes);
+
+    // Removing one TRX rewrites the counts, the TRXs after it and the header
+    cc_trxs.remove_id(NUM_TRXS - 1);
+    warm_start.ids_changed(now);
+    for (millis_t t=0; t<WARM_START_SAVE_DELAY + 1000; t++, now++) {
+        warm_start.run(cc_txs, cc_trxs, now);
+    }
+    BOOST_CHECK(eeprom.num_writes - writes <= 2 + 4 + 4 + 3);
+}
+
+
+BOOST_AUTO_TEST_CASE(restoredTiming)
+{
+    CcTx tx(1);
+    tx.restore_timing(6047 * 256 + 77, 1);
+    BOOST_CHECK_EQUAL(tx.get_window_open(), CC_TX_WINDOW_OPEN_MIN);
+
+    // The second packet arrives 2 ms late.  Measuring the period from it
+    // alone would throw away what we'd learned.
+    tx.update(1000);
+    tx.update(1000 + 6047 + 2);
+    BOOST_CHECK_EQUAL(tx.get_eta_error(), 2);
+    BOOST_CHECK(tx.get_period_x256() > 6047 * 256 + 77); // nudged...
+    BOOST_CHECK(tx.get_period_x256() < 6048 * 256);      // ...not replaced by 6049
+
+    // A restored period that's badly wrong (e.g. a different TX with the
+    // same ID) is measured again
+    CcTx other(2);
+    other.restore_timing(5000 * 256, 1);
+    other.update(1000);
+    other.update(1000 + 6010);
+    BOOST_CHECK_EQUAL(other.get_period(), 6010);
+}
+
+
+BOOST_AUTO_TEST_CASE(startupTime)
+{
+    /* Time from power-on to every sensor being known: restoring the
+     * image, against the host sending an 'n'/'N' command per sensor
+     * (not counting the time taken to send them over serial). */
+    FakeEeprom eeprom;
+    CcTxArray cc_txs;
+    CcTrxArray cc_trxs;
+    make_arrays(cc_txs, cc_trxs);
+    BOOST_REQUIRE(WarmStart(eeprom).save(cc_txs, cc_trxs));
+
+    const int REPEATS = 200;
+    using namespace std::chrono;
+
+    steady_clock::time_point start = steady_clock::now();
+    for (int r=0; r<REPEATS; r++) {
+        CcTxArray restored_txs;
+        CcTrxArray restored_trxs;
+        WarmStart(eeprom).restore(restored_txs, restored_trxs, 0);
+        BOOST_REQUIRE_EQUAL(restored_trxs.get_n(), NUM_TRXS);
+    }
+    const double warm_us = duration<double, std::micro>(steady_clock::now() - start).count() / REPEATS;
+
+    start = steady_clock::now();
+    for (int r=0; r<REPEATS; r++) {
+        CcTxArray appended_txs;
+        CcTrxArray appended_trxs;
+        for (index_t k=0; k<NUM_TXS; k++) {
+            appended_txs.append(cc_txs[k].id);
+        }
+        for (index_t k=0; k<NUM_TRXS; k++) {
+            appended_trxs.append(cc_trxs[k].id);
+        }
+        BOOST_REQUIRE_EQUAL(appended_trxs.get_n(), NUM_TRXS);
+    }
+    const double cold_us = duration<double, std::micro>(steady_clock::now() - start).count() / REPEATS;
+
+    BOOST_TEST_MESSAGE("startup with " << NUM_TXS << " TXs and " << NUM_TRXS
+            << " TRXs: restore() " << warm_us << " us, append() per ID "
+            << cold_us << " us");
+    BOOST_CHECK(warm_us < cold_us);
+}
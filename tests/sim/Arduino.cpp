@@ -0,0 +1,248 @@
+/*
+ * Arduino.cpp
+ *
+ * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
+ * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
+ * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE
+ * QUALITY AND PERFORMANCE OF THE PROGRAM IS WITH YOU. SHOULD THE PROGRAM PROVE
+ * DEFECTIVE, YOU ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ */
+
+#include <iostream>
+#include "Arduino.h"
+#include "Ether.h"
+
+uint32_t SimArduino::call_cost_us = 20;
+
+static const uint8_t UART_FIFO_LENGTH = 64;
+
+SimSerial Serial;
+
+/**************************
+ * Time                   *
+ **************************/
+
+/* Charge the caller for the time it takes to call us, unless we're
+ * being called from within a simulated ISR (in which case the
+ * clock is already being advanced by Ether::advance()). */
+static void charge_call()
+{
+    Ether& ether = Ether::instance();
+    if (!ether.in_event()) {
+        ether.advance(SimArduino::call_cost_us);
+    }
+}
+
+
+unsigned long millis()
+{
+    charge_call();
+    return (unsigned long)(uint32_t)(Ether::instance().now() / 1000);
+}
+
+
+unsigned long micros()
+{
+    charge_call();
+    return (unsigned long)(uint32_t)Ether::instance().now();
+}
+
+
+void delay(unsigned long ms)
+{
+    Ether::instance().advance((sim_time_t)ms * 1000);
+}
+
+
+void delayMicroseconds(unsigned int us)
+{
+    Ether::instance().advance(us);
+}
+
+
+void cli() {}
+void sei() {}
+
+
+/**************************
+ * SimSerial              *
+ **************************/
+
+SimSerial::SimSerial()
+: bytes_written(0), blocked_us(0), listener(NULL), echo(false), baud(115200),
+  tx_fifo(0), last_drain(0) {}
+
+
+void SimSerial::begin(const unsigned long& b)
+{
+    baud = b;
+}
+
+
+int SimSerial::available()
+{
+    return rx.size();
+}
+
+
+int SimSerial::read()
+{
+    if (rx.empty()) {
+        return -1;
+    }
+    const int c = (unsigned char)rx[0];
+    rx.erase(0, 1);
+    return c;
+}
+
+
+int SimSerial::peek()
+{
+    return rx.empty() ? -1 : (unsigned char)rx[0];
+}
+
+
+void SimSerial::drain()
+{
+    const sim_time_t now = Ether::instance().now();
+    tx_fifo -= (double)(now - last_drain) * baud / 10 / 1000000;
+    if (tx_fifo < 0) tx_fifo = 0;
+    last_drain = now;
+}
+
+
+void SimSerial::flush()
+{
+    drain();
+    const sim_time_t wait = (sim_time_t)(tx_fifo * 10 * 1000000 / baud);
+    Ether::instance().advance(wait);
+    blocked_us += wait;
+    drain();
+}
+
+
+int SimSerial::availableForWrite()
+{
+    drain();
+    return UART_FIFO_LENGTH - (int)(tx_fifo + 0.999);
+}
+
+
+size_t SimSerial::write(const uint8_t& b)
+{
+    const sim_time_t byte_time = 10 * 1000000 / baud;
+
+    /* Block until the UART has room, as HardwareSerial::write() does. */
+    drain();
+    while (tx_fifo > UART_FIFO_LENGTH - 1) {
+        Ether::instance().advance(byte_time);
+        blocked_us += byte_time;
+        drain();
+    }
+    tx_fifo += 1;
+    bytes_written++;
+
+    if (echo) {
+        std::cout.put(b);
+    }
+
+    if (listener) {
+        listener->on_byte(b);
+    }
+
+    return 1;
+}
+
+
+size_t SimSerial::write(const uint8_t* buffer, size_t size)
+{
+    for (size_t j=0; j<size; j++) {
+        write(buffer[j]);
+    }
+    return size;
+}
+
+
+size_t SimSerial::print(const __FlashStringHelper* s)
+{
+    return print(reinterpret_cast<const char*>(s));
+}
+
+
+size_t SimSerial::print(const char* s)
+{
+    return write(reinterpret_cast<const uint8_t*>(s), strlen(s));
+}
+
+
+size_t SimSerial::print(const std::string& s)
+{
+    return print(s.c_str());
+}
+
+
+size_t SimSerial::print(char c)
+{
+    return write((uint8_t)c);
+}
+
+
+size_t SimSerial::print_number(unsigned long n, int base, const bool& negative)
+{
+    char buf[8 * sizeof(long) + 2];
+    char* str = &buf[sizeof(buf) - 1];
+    *str = '\0';
+
+    do {
+        const unsigned long m = n;
+        n /= base;
+        const char c = m - base * n;
+        *--str = c < 10 ? c + '0' : c + 'A' - 10;
+    } while (n);
+
+    if (negative) *--str = '-';
+    return print(str);
+}
+
+
+size_t SimSerial::print(int n, int base)
+{
+    return print((long)n, base);
+}
+
+
+size_t SimSerial::print(unsigned int n, int base)
+{
+    return print((unsigned long)n, base);
+}
+
+
+size_t SimSerial::print(long n, int base)
+{
+    if (base == DEC && n < 0) {
+        return print_number(-n, base, true);
+    }
+    return print_number(n, base, false);
+}
+
+
+size_t SimSerial::print(unsigned long n, int base)
+{
+    return print_number(n, base, false);
+}
+
+
+size_t SimSerial::print(double n, int digits)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.*f", digits, n);
+    return print(buf);
+}
+
+
+size_t SimSerial::println()
+{
+    return print("\r\n");
+}
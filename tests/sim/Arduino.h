@@ -0,0 +1,121 @@
+/*
+ * Arduino.h
+ *
+ *  Just enough of the Arduino core for Manager and nanode_rf_utils to build
+ *  on a PC.  Time comes from the virtual clock in Ether; Serial models a
+ *  115200 baud UART with a 64 byte hardware buffer, so printing blocks
+ *  (in virtual time) just like it does on the Nanode.
+ *
+ *  Every call to millis() or micros() costs SimArduino::call_cost_us
+ *  of virtual time.  This is what lets busy-wait loops like
+ *  Manager::wait_for_response() make progress.
+ *
+ * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
+ * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
+ * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE
+ * QUALITY AND PERFORMANCE OF THE PROGRAM IS WITH YOU. SHOULD THE PROGRAM PROVE
+ * DEFECTIVE, YOU ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ */
+
+#ifndef SIM_ARDUINO_H_
+#define SIM_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <string>
+#include "avr/pgmspace.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void cli();
+void sei();
+
+namespace SimArduino {
+    extern uint32_t call_cost_us; /* virtual time consumed by each millis()/micros() */
+}
+
+/**
+ * Sink for everything the firmware prints.
+ */
+class SerialListener {
+public:
+    virtual ~SerialListener() {}
+    virtual void on_byte(const uint8_t& b) = 0;
+};
+
+
+class SimSerial {
+public:
+    SimSerial();
+
+    void begin(const unsigned long& baud);
+    int  available();
+    int  read();
+    int  peek();
+    void flush();
+    int  availableForWrite();
+
+    size_t write(const uint8_t& b);
+    size_t write(const uint8_t* buffer, size_t size);
+
+    size_t print(const __FlashStringHelper* s);
+    size_t print(const char* s);
+    size_t print(const std::string& s);
+    size_t print(char c);
+    size_t print(int n, int base = DEC);
+    size_t print(unsigned int n, int base = DEC);
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+
+    size_t println();
+    template <class T> size_t println(const T& x)
+    {
+        const size_t n = print(x);
+        return n + println();
+    }
+    template <class T> size_t println(const T& x, int base)
+    {
+        const size_t n = print(x, base);
+        return n + println();
+    }
+
+    /* Host-side hooks */
+    void inject(const std::string& input) { rx += input; }
+    void set_listener(SerialListener* l) { listener = l; }
+    void set_echo(const bool& e) { echo = e; }
+    uint32_t bytes_written;
+    uint32_t blocked_us;  /* virtual time spent waiting for the UART */
+
+private:
+    void drain();
+    size_t print_number(unsigned long n, int base, const bool& negative);
+
+    std::string rx;
+    SerialListener* listener;
+    bool echo;
+    uint32_t baud;
+    double tx_fifo;             /* bytes still waiting in the UART */
+    unsigned long long last_drain;
+};
+
+extern SimSerial Serial;
+
+#endif /* SIM_ARDUINO_H_ */
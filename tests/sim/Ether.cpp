@@ -0,0 +1,189 @@
+/*
+ * Ether.cpp
+ *
+ * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
+ * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
+ * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE
+ * QUALITY AND PERFORMANCE OF THE PROGRAM IS WITH YOU. SHOULD THE PROGRAM PROVE
+ * DEFECTIVE, YOU ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ */
+
+#include <string.h>
+#include "Ether.h"
+
+/******************************
+ * SimStats                   *
+ ******************************/
+
+void SimStats::clear()
+{
+    transmissions = collisions = polls_sent = polls_answered = polls_lost =
+            tx_sent = rx_delivered = rx_dropped = 0;
+}
+
+
+SimStats SimStats::operator-(const SimStats& other) const
+{
+    SimStats diff;
+    diff.transmissions  = transmissions  - other.transmissions;
+    diff.collisions     = collisions     - other.collisions;
+    diff.polls_sent     = polls_sent     - other.polls_sent;
+    diff.polls_answered = polls_answered - other.polls_answered;
+    diff.polls_lost     = polls_lost     - other.polls_lost;
+    diff.tx_sent        = tx_sent        - other.tx_sent;
+    diff.rx_delivered   = rx_delivered   - other.rx_delivered;
+    diff.rx_dropped     = rx_dropped     - other.rx_dropped;
+    return diff;
+}
+
+
+/******************************
+ * Ether                      *
+ ******************************/
+
+Ether& Ether::instance()
+{
+    static Ether ether;
+    return ether;
+}
+
+
+Ether::Ether()
+: bitrate(38400), preamble_bytes(5), time(0), seq(0), handling_event(false),
+  rng(1) {}
+
+
+void Ether::advance(const sim_time_t& duration)
+{
+    const sim_time_t target = time + duration;
+
+    while (!events.empty() && events.top().time <= target) {
+        const Event event = events.top();
+        events.pop();
+        time = event.time;
+        handling_event = true;
+        handle(event);
+        handling_event = false;
+    }
+
+    time = target;
+}
+
+
+void Ether::schedule(SimNode* node, const sim_time_t& when, const uint8_t& tag)
+{
+    Event event;
+    event.time = when < time ? time : when;
+    event.seq = seq++;
+    event.node = node;
+    event.tag = tag;
+    event.transmission = 0;
+    events.push(event);
+}
+
+
+sim_time_t Ether::airtime(const uint8_t& length) const
+{
+    return ((sim_time_t)(length + preamble_bytes) * 8 * 1000000) / bitrate;
+}
+
+
+sim_time_t Ether::transmit(SimNode* src, const uint8_t* bytes, const uint8_t& length)
+{
+    uint32_t t;
+    if (free_slots.empty()) {
+        t = transmissions.size();
+        transmissions.push_back(Transmission());
+    } else {
+        t = free_slots.back();
+        free_slots.pop_back();
+    }
+
+    Transmission& tr = transmissions[t];
+    tr.src = src;
+    tr.length = length < SIM_MAX_PACKET_LENGTH ? length : SIM_MAX_PACKET_LENGTH;
+    memcpy(tr.bytes, bytes, tr.length);
+    tr.end = time + airtime(length);
+    tr.corrupt = false;
+
+    /* Anything still on air overlaps with us.  Both are lost. */
+    for (size_t j=0; j<in_flight.size(); j++) {
+        Transmission& other = transmissions[in_flight[j]];
+        if (!other.corrupt) {
+            other.corrupt = true;
+            stats.collisions++;
+        }
+        if (!tr.corrupt) {
+            tr.corrupt = true;
+            stats.collisions++;
+        }
+    }
+
+    in_flight.push_back(t);
+    stats.transmissions++;
+
+    Event event;
+    event.time = tr.end;
+    event.seq = seq++;
+    event.node = NULL;
+    event.tag = 0;
+    event.transmission = t;
+    events.push(event);
+
+    return tr.end - time;
+}
+
+
+void Ether::handle(const Event& event)
+{
+    if (event.node) {
+        event.node->on_timer(time, event.tag);
+    } else {
+        end_transmission(event.transmission);
+    }
+}
+
+
+void Ether::end_transmission(const uint32_t& t)
+{
+    for (size_t j=0; j<in_flight.size(); j++) {
+        if (in_flight[j] == t) {
+            in_flight[j] = in_flight.back();
+            in_flight.pop_back();
+            break;
+        }
+    }
+
+    /* Copy out of the slot first; listeners may transmit
+     * in response, which can re-use the slot. */
+    Transmission tr = transmissions[t];
+    free_slots.push_back(t);
+
+    if (tr.corrupt) {
+        /* Flipping the LSB of the last byte breaks both the TRX checksum
+         * and the Manchester encoding used by TXs (01->00 or 10->11)
+         * without changing the packet type encoded in the first byte. */
+        tr.bytes[tr.length-1] ^= 0x01;
+    }
+
+    for (size_t j=0; j<listeners.size(); j++) {
+        if (listeners[j] != tr.src) {
+            listeners[j]->on_receive(tr.bytes, tr.length, tr.corrupt);
+        }
+    }
+}
+
+
+double Ether::uniform(const double& lo, const double& hi)
+{
+    std::uniform_real_distribution<double> dist(lo, hi);
+    return dist(rng);
+}
+
+
+bool Ether::chance(const double& p)
+{
+    return p > 0 && uniform(0, 1) < p;
+}
@@ -0,0 +1,140 @@
+/*
+ * Ether.h
+ *
+ *  Discrete-event model of the 433MHz channel shared by the Nanode and
+ *  every CC TX / CC TRX in the building.  Owns the virtual clock which
+ *  drives millis(), micros() and delay() in the host build (see Arduino.h
+ *  in this directory).
+ *
+ *  The channel model is deliberately simple:
+ *    - every node can hear every other node;
+ *    - any two transmissions which overlap in time corrupt each other
+ *      (for every listener, including the Nanode);
+ *    - airtime is (preamble + payload) bytes at a fixed bitrate.
+ *
+ * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
+ * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
+ * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE
+ * QUALITY AND PERFORMANCE OF THE PROGRAM IS WITH YOU. SHOULD THE PROGRAM PROVE
+ * DEFECTIVE, YOU ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ */
+
+#ifndef SIM_ETHER_H_
+#define SIM_ETHER_H_
+
+#include <stdint.h>
+#include <queue>
+#include <vector>
+#include <random>
+
+typedef uint64_t sim_time_t; /* microseconds since power-on */
+
+const uint8_t SIM_MAX_PACKET_LENGTH = 22;
+
+/**
+ * Anything which can hear the ether or be woken by a timer:
+ * simulated sensors and the simulated RFM12b.
+ */
+class SimNode {
+public:
+    virtual ~SimNode() {}
+
+    /* Called when a timer set with Ether::schedule() fires. */
+    virtual void on_timer(const sim_time_t& now, const uint8_t& tag) {}
+
+    /* Called at the end of every transmission sent by another node.
+     * If corrupt is true then bytes has been garbled by a collision. */
+    virtual void on_receive(const uint8_t* bytes, const uint8_t& length,
+            const bool& corrupt) {}
+};
+
+
+struct SimStats {
+    uint32_t transmissions,
+             collisions,     /* transmissions corrupted by an overlap */
+             polls_sent,     /* by the Nanode */
+             polls_answered, /* replies sent by TRXs */
+             polls_lost,     /* polls a TRX heard but chose not to answer */
+             tx_sent,        /* CC TX transmissions */
+             rx_delivered,   /* complete packets handed to the RFM12b buffer */
+             rx_dropped;     /* packets lost because the RFM12b buffer was full */
+
+    SimStats() { clear(); }
+    void clear();
+    SimStats operator-(const SimStats& other) const;
+};
+
+
+class Ether {
+public:
+    static Ether& instance();
+
+    const sim_time_t& now() const { return time; }
+
+    /* True while an event is being handled.  Used to stop millis()
+     * advancing the clock from within a simulated ISR. */
+    bool in_event() const { return handling_event; }
+
+    /* Advance the virtual clock by duration, firing every event due. */
+    void advance(const sim_time_t& duration);
+
+    void schedule(SimNode* node, const sim_time_t& when, const uint8_t& tag = 0);
+
+    /* Start a transmission from src at now().  Returns the airtime. */
+    sim_time_t transmit(SimNode* src, const uint8_t* bytes, const uint8_t& length);
+
+    sim_time_t airtime(const uint8_t& length) const;
+
+    void add_listener(SimNode* node) { listeners.push_back(node); }
+
+    /* Random helpers.  All randomness in the simulation comes from here
+     * so that runs are reproducible from the seed. */
+    void seed(const uint32_t& s) { rng.seed(s); }
+    double uniform(const double& lo, const double& hi);
+    bool chance(const double& p);
+
+    uint32_t bitrate;          /* bits per second */
+    uint8_t  preamble_bytes;   /* preamble + sync word overhead per packet */
+
+    SimStats stats;
+
+private:
+    Ether();
+
+    struct Transmission {
+        SimNode* src;
+        uint8_t  bytes[SIM_MAX_PACKET_LENGTH];
+        uint8_t  length;
+        sim_time_t end;
+        bool     corrupt;
+    };
+
+    struct Event {
+        sim_time_t time;
+        uint32_t   seq;        /* keeps events at the same time in FIFO order */
+        SimNode*   node;       /* NULL if this is the end of a transmission */
+        uint8_t    tag;
+        uint32_t   transmission;
+
+        bool operator>(const Event& other) const {
+            return time != other.time ? time > other.time : seq > other.seq;
+        }
+    };
+
+    void handle(const Event& event);
+    void end_transmission(const uint32_t& t);
+
+    sim_time_t time;
+    uint32_t   seq;
+    bool       handling_event;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event> > events;
+    std::vector<Transmission> transmissions; /* slots, re-used once free */
+    std::vector<uint32_t> in_flight;         /* indices into transmissions */
+    std::vector<uint32_t> free_slots;
+    std::vector<SimNode*> listeners;
+    std::mt19937 rng;
+};
+
+#endif /* SIM_ETHER_H_ */
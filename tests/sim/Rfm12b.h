@@ -0,0 +1,96 @@
+/*
+ * Rfm12b.h
+ *
+ *  Simulated stand-in for nanode_rf_utils' Rfm12b.  Placed ahead of
+ *  nanode_rf_utils on the include path so that Manager links against
+ *  this instead of the SPI driver.
+ *
+ *  Received packets are fed into rx_packet_buffer one byte at a time via
+ *  RxPacket::append(), exactly as the real RFM12b ISR does, so all of
+ *  RxPacketFromSensor's post-processing runs unmodified.
+ *
+ * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
+ * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
+ * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE
+ * QUALITY AND PERFORMANCE OF THE PROGRAM IS WITH YOU. SHOULD THE PROGRAM PROVE
+ * DEFECTIVE, YOU ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ */
+
+#ifndef RFM12B_H_
+#define RFM12B_H_
+
+#include <Arduino.h>
+#include <Packet.h>
+#include "Ether.h"
+
+template <class RxPacketType>
+class SimPacketBuffer {
+public:
+    RxPacketType packets[PACKET_BUF_LENGTH];
+};
+
+
+template <class RxPacketType>
+class Rfm12b : public SimNode {
+public:
+    SimPacketBuffer<RxPacketType> rx_packet_buffer;
+
+    Rfm12b(): rx_enabled(false), registered(false) {}
+
+    void init()
+    {
+        if (!registered) {
+            Ether::instance().add_listener(this);
+            registered = true;
+        }
+    }
+
+    void enable_rx() { rx_enabled = true; }
+
+    /**
+     * Blocks until finished TX, as the real driver does.
+     */
+    void transmit(const byte* data, const index_t& length,
+            const bool& enable_rx_when_done = true)
+    {
+        Ether& ether = Ether::instance();
+
+        if (length == 11 && data[6] == 0x50 && data[7] == 0x53) {
+            ether.stats.polls_sent++;
+        }
+
+        rx_enabled = false;
+        const sim_time_t duration = ether.transmit(this, data, length);
+        ether.advance(duration);
+        rx_enabled = enable_rx_when_done;
+    }
+
+    /* Simulated ISR: called by Ether at the end of every transmission. */
+    void on_receive(const uint8_t* bytes, const uint8_t& length, const bool& corrupt)
+    {
+        if (!rx_enabled) return;
+
+        Ether& ether = Ether::instance();
+
+        for (index_t i=0; i<PACKET_BUF_LENGTH; i++) {
+            RxPacketType& packet = rx_packet_buffer.packets[i];
+            if (!packet.done()) {
+                for (uint8_t j=0; j<length && !packet.done(); j++) {
+                    packet.append(bytes[j]);
+                }
+                ether.stats.rx_delivered++;
+                return;
+            }
+        }
+
+        ether.stats.rx_dropped++;
+    }
+
+private:
+    bool rx_enabled;
+    bool registered;
+};
+
+#endif /* RFM12B_H_ */
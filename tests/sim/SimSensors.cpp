@@ -0,0 +1,179 @@
+/*
+ * SimSensors.cpp
+ *
+ * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
+ * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
+ * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE
+ * QUALITY AND PERFORMANCE OF THE PROGRAM IS WITH YOU. SHOULD THE PROGRAM PROVE
+ * DEFECTIVE, YOU ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ */
+
+#include <Arduino.h>
+#include <utils.h>
+#include "SimSensors.h"
+
+/* Sum of all preceding bytes, as checked by Packet::verify_checksum() */
+static uint8_t checksum(const uint8_t* bytes, const uint8_t& length)
+{
+    uint8_t sum = 0;
+    for (uint8_t j=0; j<length; j++) {
+        sum += bytes[j];
+    }
+    return sum;
+}
+
+
+/* 1 -> 10, 0 -> 01.  Most significant bit first. */
+static void manchesterise(const uint8_t& src, uint8_t* dst)
+{
+    for (uint8_t half=0; half<2; half++) {
+        uint8_t out = 0;
+        for (uint8_t bit=0; bit<4; bit++) {
+            out <<= 2;
+            out |= (src & (0x80 >> (half*4 + bit))) ? 0b10 : 0b01;
+        }
+        dst[half] = out;
+    }
+}
+
+
+/******************************
+ * SimCcTrx                   *
+ ******************************/
+
+SimCcTrx::SimCcTrx(const uint32_t& _id, const SimTrxConfig& _config)
+: id(_id), paired(false), steady(false), unplugged(false), config(_config),
+  watts(0), state(true), reply_pending(false) {}
+
+
+void SimCcTrx::start()
+{
+    Ether& ether = Ether::instance();
+    watts = ether.uniform(0, 3000);
+    steady = config.steady > 0 && ether.chance(config.steady);
+    unplugged = config.unplugged > 0 && ether.chance(config.unplugged);
+    ether.add_listener(this);
+    ether.schedule(this, ether.now() + ether.uniform(0, config.pair_spread_ms * 1000),
+            PAIR_TIMER);
+}
+
+
+void SimCcTrx::on_timer(const sim_time_t& now, const uint8_t& tag)
+{
+    Ether& ether = Ether::instance();
+
+    switch (tag) {
+    case PAIR_TIMER:
+        if (!paired) {
+            send('C', 'O');
+            ether.schedule(this, now + ether.uniform(1000000, 3000000), PAIR_TIMER);
+        }
+        break;
+    case REPLY_TIMER:
+        reply_pending = false;
+        /* A wandering load, so consecutive readings differ */
+        if (!steady) {
+            watts += ether.uniform(-20, 20);
+            if (watts > 3000) watts = 0;
+        }
+        send(0x00, 0x00);
+        ether.stats.polls_answered++;
+        break;
+    }
+}
+
+
+void SimCcTrx::on_receive(const uint8_t* bytes, const uint8_t& length,
+        const bool& corrupt)
+{
+    if (corrupt || length != 11 || bytes[0] != 0x46) return;
+    if (utils::bytes_to_uint32(bytes+1) != id) return;
+
+    Ether& ether = Ether::instance();
+    const uint8_t cmd1 = bytes[6], cmd2 = bytes[7];
+
+    if (cmd1 == 0x41 && cmd2 == 0x4B) {        // ACK
+        paired = true;
+    } else if (cmd1 == 'O') {                  // ON / OF(F)
+        state = cmd2 == 'N';
+    } else if (cmd1 == 0x50 && cmd2 == 0x53) { // Poll
+        if (!paired || reply_pending || unplugged) return;
+        if (ether.chance(config.loss)) {
+            ether.stats.polls_lost++;
+            return;
+        }
+        const double delay_ms = config.latency_ms +
+                ether.uniform(-config.jitter_ms, config.jitter_ms);
+        reply_pending = true;
+        ether.schedule(this, ether.now() + (delay_ms > 0 ? delay_ms * 1000 : 0),
+                REPLY_TIMER);
+    }
+}
+
+
+void SimCcTrx::send(const uint8_t& cmd1, const uint8_t& cmd2)
+{
+    uint8_t bytes[12] = {0x52, 0, 0, 0, 0, 0, cmd1, cmd2,
+            (uint8_t)(watts & 0xFF), (uint8_t)(watts >> 8),
+            (uint8_t)(state ? 0x53 : 0x00), 0};
+    utils::uint_to_bytes(id, bytes+1);
+    bytes[11] = checksum(bytes, 11);
+    Ether::instance().transmit(this, bytes, 12);
+}
+
+
+/******************************
+ * SimCcTx                    *
+ ******************************/
+
+SimCcTx::SimCcTx(const uint16_t& _id, const SimTxConfig& config)
+: id(_id & 0x0FFF), period_us(0), watts(0), pair_requests_left(NUM_PAIR_REQUESTS)
+{
+    Ether& ether = Ether::instance();
+    period_us = (config.period_ms + ether.uniform(-config.drift_ms, config.drift_ms)) * 1000;
+}
+
+
+void SimCcTx::start()
+{
+    Ether& ether = Ether::instance();
+    watts = ether.uniform(100, 5000);
+    ether.schedule(this, ether.now() + ether.uniform(0, period_us));
+}
+
+
+void SimCcTx::on_timer(const sim_time_t& now, const uint8_t& tag)
+{
+    Ether& ether = Ether::instance();
+
+    send(pair_requests_left > 0);
+    if (pair_requests_left > 0) {
+        pair_requests_left--;
+    }
+
+    watts += ether.uniform(-50, 50);
+    if (watts > 0x7FFF) watts = 0;
+
+    /* Real TXs jitter by a millisecond or two around their period */
+    ether.schedule(this, now + period_us + (sim_time_t)ether.uniform(0, 2000));
+}
+
+
+void SimCcTx::send(const bool& pair_request)
+{
+    const uint8_t decoded[8] = {
+            (uint8_t)((pair_request ? 0x80 : 0x00) | (id >> 8)),
+            (uint8_t)(id & 0xFF),
+            (uint8_t)(0x80 | (watts >> 8)), (uint8_t)(watts & 0xFF),
+            0, 0, 0, 0};
+
+    uint8_t bytes[16];
+    for (uint8_t j=0; j<8; j++) {
+        manchesterise(decoded[j], bytes + j*2);
+    }
+
+    Ether::instance().stats.tx_sent++;
+    Ether::instance().transmit(this, bytes, 16);
+}
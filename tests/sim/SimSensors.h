@@ -0,0 +1,95 @@
+/*
+ * SimSensors.h
+ *
+ *  Simulated Current Cost transmitters (TX) and EDF / CC transceivers (TRX).
+ *
+ * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
+ * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
+ * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE
+ * QUALITY AND PERFORMANCE OF THE PROGRAM IS WITH YOU. SHOULD THE PROGRAM PROVE
+ * DEFECTIVE, YOU ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ */
+
+#ifndef SIM_SENSORS_H_
+#define SIM_SENSORS_H_
+
+#include "Ether.h"
+
+struct SimTrxConfig {
+    double latency_ms;   /* mean delay between end of poll and start of reply */
+    double jitter_ms;    /* reply delay is uniform in latency_ms +/- jitter_ms */
+    double loss;         /* probability that a heard poll goes unanswered */
+    double pair_spread_ms; /* first pair request is uniform in [0, pair_spread_ms) */
+    double steady;       /* fraction of TRXs whose load never changes */
+    double unplugged;    /* fraction of TRXs which are unplugged once paired */
+
+    SimTrxConfig()
+    : latency_ms(20), jitter_ms(10), loss(0.05), pair_spread_ms(60000), steady(0),
+      unplugged(0) {}
+};
+
+
+struct SimTxConfig {
+    double period_ms;    /* nominal sample period */
+    double drift_ms;     /* each TX's period is uniform in period_ms +/- drift_ms */
+
+    SimTxConfig(): period_ms(6000), drift_ms(50) {}
+};
+
+
+/**
+ * CC TRX, e.g. an EDF EcoManager Wireless Transmitter Plug.
+ *
+ * Sends pair requests until ACKed, then answers polls.
+ */
+class SimCcTrx : public SimNode {
+public:
+    SimCcTrx(const uint32_t& _id, const SimTrxConfig& _config);
+    void start();
+    void on_timer(const sim_time_t& now, const uint8_t& tag);
+    void on_receive(const uint8_t* bytes, const uint8_t& length, const bool& corrupt);
+
+    const uint32_t id;
+    bool paired;
+    bool steady; /* load never changes */
+    bool unplugged; /* stops answering polls once paired */
+
+private:
+    enum {PAIR_TIMER, REPLY_TIMER};
+
+    void send(const uint8_t& cmd1, const uint8_t& cmd2);
+
+    const SimTrxConfig& config;
+    uint16_t watts;
+    bool state;
+    bool reply_pending;
+};
+
+
+/**
+ * CC transmit-only sensor, e.g. a whole-house "sensable" TX.
+ *
+ * Transmits every period with a pair flag set on its first few
+ * transmissions (as if its pair button had just been pressed).
+ */
+class SimCcTx : public SimNode {
+public:
+    SimCcTx(const uint16_t& _id, const SimTxConfig& _config);
+    void start();
+    void on_timer(const sim_time_t& now, const uint8_t& tag);
+
+    const uint16_t id;
+
+private:
+    static const uint8_t NUM_PAIR_REQUESTS = 3;
+
+    void send(const bool& pair_request);
+
+    sim_time_t period_us;
+    uint16_t watts;
+    uint8_t  pair_requests_left;
+};
+
+#endif /* SIM_SENSORS_H_ */
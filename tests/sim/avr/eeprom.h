@@ -0,0 +1,31 @@
+/*
+ * avr/eeprom.h
+ *
+ *  The ATmega328's 1 KB EEPROM, in RAM.  It starts out erased (0xFF)
+ *  every time the simulator runs and writes complete instantly.
+ */
+
+#ifndef SIM_AVR_EEPROM_H_
+#define SIM_AVR_EEPROM_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define E2END 0x3FF
+
+inline uint8_t* sim_eeprom()
+{
+    static uint8_t bytes[E2END + 1];
+    static bool erased = false;
+    if (!erased) {
+        memset(bytes, 0xFF, sizeof(bytes));
+        erased = true;
+    }
+    return bytes;
+}
+
+inline uint8_t eeprom_read_byte(const uint8_t* addr) { return sim_eeprom()[(uintptr_t)addr]; }
+inline void eeprom_write_byte(uint8_t* addr, uint8_t value) { sim_eeprom()[(uintptr_t)addr] = value; }
+#define eeprom_is_ready() (1)
+
+#endif /* SIM_AVR_EEPROM_H_ */
@@ -0,0 +1,395 @@
+/*
+ * simulator.cpp
+ *
+ *  Runs the real Manager against a simulated building full of CC TXs and
+ *  CC TRXs, in virtual time, and reports how many readings Manager
+ *  captures per SAMPLE_PERIOD.
+ *
+ *  Every sensor pairs itself over the air (Manager starts in auto_pair mode)
+ *  so the run starts with a warm-up phase.  Statistics only cover the
+ *  measurement phase which follows.
+ *
+ * THERE IS NO WARRANTY FOR THE PROGRAM, TO THE EXTENT PERMITTED BY APPLICABLE
+ * LAW. EXCEPT WHEN OTHERWISE STATED IN WRITING THE COPYRIGHT HOLDERS AND/OR OTHER
+ * PARTIES PROVIDE THE PROGRAM “AS IS” WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE
+ * QUALITY AND PERFORMANCE OF THE PROGRAM IS WITH YOU. SHOULD THE PROGRAM PROVE
+ * DEFECTIVE, YOU ASSUME THE COST OF ALL NECESSARY SERVICING, REPAIR OR CORRECTION.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "Arduino.h"
+#include "Ether.h"
+#include "SimSensors.h"
+#include "../BinaryDecoder.h"
+#include "../../Manager.h"
+
+/* Time the main loop takes to go round once, on top of the
+ * time charged for each millis() call made within Manager::run(). */
+const sim_time_t LOOP_COST_US = 50;
+
+/**
+ * Counts what Manager prints, i.e. what the host logger would see.
+ * Understands both JSON and binary output.
+ */
+class OutputCounter : public SerialListener {
+public:
+    OutputCounter()
+    : trx_readings(0), trx_replies(0), tx_readings(0), max_trx_reading_gap(0),
+      aggregates_merged(0) {}
+
+    void on_byte(const uint8_t& b)
+    {
+        using namespace binary_decoder;
+
+        switch (decoder.feed(b)) {
+        case StreamDecoder::READING:
+            if (decoder.reading().type == TYPE_CC_TRX) {
+                on_trx_reading(decoder.reading().id);
+                trx_replies += decoder.reading().reply_to_poll;
+            } else {
+                tx_readings++;
+            }
+            break;
+        case StreamDecoder::TEXT:
+            on_line(decoder.text());
+            break;
+        case StreamDecoder::NOTHING:
+            break;
+        }
+    }
+
+    void on_line(const std::string& line)
+    {
+        if (line.find("\"window_s\": ") != std::string::npos) {
+            on_aggregate(line);
+        }
+
+        if (starts_with(line, "{\"type\": \"trx\"")) {
+            on_trx_reading(strtoul(line.c_str() + line.find("\"id\": ") + 6, NULL, 10));
+            if (line.find("\"reply_to_poll\": 1") != std::string::npos) {
+                trx_replies++;
+            }
+        } else if (starts_with(line, "{\"type\": \"trx_batch\"")) {
+            // Replies to the last roll call: "readings": {"id": watts, ...}
+            size_t pos = line.find("\"readings\": {") + 13;
+            while ((pos = line.find('"', pos)) != std::string::npos) {
+                on_trx_reading(strtoul(line.c_str() + pos + 1, NULL, 10));
+                trx_replies++;
+                pos = line.find(':', pos);
+            }
+        } else if (starts_with(line, "{\"type\": \"tx\"")) {
+            tx_readings++;
+        } else if (starts_with(line, "{\"demoted_trxs\"")) {
+            manager_stats = line.substr(0, line.find_last_not_of("\r\n") + 1);
+        } else if (starts_with(line, "{\"pw\": {\"type\": \"tx\"")) {
+            tx_ids_paired.insert(line.substr(line.find("\"id\""), line.find('}') - line.find("\"id\"")));
+        }
+    }
+
+    /* Longest time (us) any TRX has gone without a reading since
+     * max_trx_reading_gap was last reset. */
+    sim_time_t trx_reading_gap() const
+    {
+        sim_time_t gap = max_trx_reading_gap;
+        const sim_time_t now = Ether::instance().now();
+        for (std::map<uint32_t, sim_time_t>::const_iterator it = last_trx_reading.begin();
+                it != last_trx_reading.end(); it++) {
+            gap = std::max(gap, now - it->second);
+        }
+        return gap;
+    }
+
+    /* Start counting trx_periods_by_id afresh */
+    void start_periods()
+    {
+        trx_periods_by_id.clear();
+        trx_period_origin.clear();
+        last_trx_period.clear();
+    }
+
+    uint32_t trx_readings, trx_replies, tx_readings;
+    /* SAMPLE_PERIODs since start_periods() in which each TRX had at
+     * least one reading.  A TRX can have two readings in one period,
+     * e.g. a retry and the next roll call, but this counts one.
+     * Each TRX's periods start half a period before its first reading,
+     * so that readings a roll call apart fall in different periods. */
+    std::map<uint32_t, uint32_t> trx_periods_by_id;
+    std::map<uint32_t, sim_time_t> last_trx_reading;
+    sim_time_t max_trx_reading_gap;
+    std::set<std::string> tx_ids_paired;
+    std::string manager_stats; /* reply to the 'c' command */
+    uint32_t aggregates_merged; /* summaries covering more than one window */
+    binary_decoder::StreamDecoder decoder;
+
+private:
+    std::map<uint32_t, sim_time_t> trx_period_origin, last_trx_period;
+
+    void on_trx_reading(const uint32_t& id)
+    {
+        const sim_time_t now = Ether::instance().now();
+        trx_readings++;
+
+        if (!trx_period_origin.count(id)) {
+            trx_period_origin[id] = now - SAMPLE_PERIOD * 1000 / 2;
+        }
+        const sim_time_t period = (now - trx_period_origin[id]) / (SAMPLE_PERIOD * 1000);
+        if (!last_trx_period.count(id) || last_trx_period[id] != period) {
+            trx_periods_by_id[id]++;
+            last_trx_period[id] = period;
+        }
+        if (last_trx_reading.count(id)) {
+            max_trx_reading_gap = std::max(max_trx_reading_gap, now - last_trx_reading[id]);
+        }
+        last_trx_reading[id] = now;
+    }
+
+    /* Sensors send at most one reading per SAMPLE_PERIOD, so a summary
+     * with more readings than its window can hold must have swallowed
+     * the next window too. */
+    void on_aggregate(const std::string& line)
+    {
+        const uint32_t window_s = strtoul(line.c_str() + line.find("\"window_s\": ") + 12, NULL, 10);
+        const uint32_t n = strtoul(line.c_str() + line.find("\"n\": ") + 5, NULL, 10);
+        if (n > window_s * 1000 / SAMPLE_PERIOD + 1) {
+            aggregates_merged++;
+        }
+    }
+
+    static bool starts_with(const std::string& s, const char* prefix)
+    {
+        return s.compare(0, strlen(prefix), prefix) == 0;
+    }
+};
+
+
+static void usage(const char* argv0)
+{
+    std::cerr << "Usage: " << argv0 << " [options]\n"
+              << "  -n NUM    number of CC TRXs (default 50)\n"
+              << "  -m NUM    number of CC TXs (default 2)\n"
+              << "  -p NUM    number of SAMPLE_PERIODs to measure (default 50)\n"
+              << "  -l MS     mean TRX reply latency (default 20)\n"
+              << "  -j MS     TRX reply jitter, +/- (default 10)\n"
+              << "  -x PROB   probability a TRX ignores a poll (default 0.05)\n"
+              << "  -d MS     CC TX period drift, +/- (default 50)\n"
+              << "  -a FRAC   fraction of TRXs whose load never changes (default 0)\n"
+              << "  -g FRAC   fraction of TRXs unplugged once paired (default 0)\n"
+              << "  -c US     virtual time charged per millis() call (default 20)\n"
+              << "  -s SEED   random seed (default 1)\n"
+              << "  -u BAUD   serial port speed (default 115200)\n"
+              << "  -b        switch Manager to binary output\n"
+              << "  -e CMDS   send CMDS to Manager's serial port at power-on\n"
+              << "            (use , for carriage return, e.g. -e 'm,p,')\n"
+              << "  -v        echo Manager's serial output\n";
+    exit(1);
+}
+
+
+int main(int argc, char** argv)
+{
+    uint32_t num_trxs = 50, num_txs = 2, periods = 50, seed = 1, baud = 115200;
+    bool verbose = false, binary = false;
+    std::string commands;
+    SimTrxConfig trx_config;
+    SimTxConfig  tx_config;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:m:p:l:j:x:d:a:g:c:s:u:be:vh")) != -1) {
+        switch (opt) {
+        case 'n': num_trxs = atoi(optarg); break;
+        case 'm': num_txs = atoi(optarg); break;
+        case 'p': periods = atoi(optarg); break;
+        case 'l': trx_config.latency_ms = atof(optarg); break;
+        case 'j': trx_config.jitter_ms = atof(optarg); break;
+        case 'x': trx_config.loss = atof(optarg); break;
+        case 'd': tx_config.drift_ms = atof(optarg); break;
+        case 'a': trx_config.steady = atof(optarg); break;
+        case 'g': trx_config.unplugged = atof(optarg); break;
+        case 'c': SimArduino::call_cost_us = atoi(optarg); break;
+        case 's': seed = atoi(optarg); break;
+        case 'u': baud = atoi(optarg); break;
+        case 'b': binary = true; break;
+        case 'e': commands += optarg; break;
+        case 'v': verbose = true; break;
+        default: usage(argv[0]);
+        }
+    }
+
+    if (num_txs > 0x0FFF) {
+        std::cerr << "At most " << 0x0FFF << " CC TXs (IDs are 12 bits)\n";
+        return 1;
+    }
+
+    Ether& ether = Ether::instance();
+    ether.seed(seed);
+
+    /* Give each sensor ~100 ms of pairing airtime so that
+     * warm-up doesn't turn into a collision storm. */
+    trx_config.pair_spread_ms = 100.0 * num_trxs + 1000;
+
+    OutputCounter counter;
+    Serial.set_listener(&counter);
+    Serial.set_echo(verbose);
+    Serial.begin(baud);
+
+    Manager manager;
+    manager.init();
+
+    if (binary) {
+        commands += 'x';
+    }
+    for (size_t j=0; j<commands.size(); j++) {
+        if (commands[j] == ',') commands[j] = '\r';
+    }
+    Serial.inject(commands);
+
+    /************ Create sensors with unique IDs ************/
+    std::set<uint32_t> ids;
+    std::vector<SimCcTrx*> trxs;
+    while (trxs.size() < num_trxs) {
+        const uint32_t id = ether.uniform(1, 0xFFFFFFFE);
+        if (ids.insert(id).second) {
+            trxs.push_back(new SimCcTrx(id, trx_config));
+            trxs.back()->start();
+        }
+    }
+
+    ids.clear();
+    std::vector<SimCcTx*> txs;
+    while (txs.size() < num_txs) {
+        const uint16_t id = ether.uniform(1, 0x0FFF);
+        if (ids.insert(id).second) {
+            txs.push_back(new SimCcTx(id, tx_config));
+            txs.back()->start();
+        }
+    }
+
+    const clock_t wall_start = clock();
+
+    /************ Warm up: wait for everything to pair ************/
+    /* TRXs know when they've been ACKed.  TXs don't, so for them we
+     * rely on Manager's "pw" lines. */
+    const sim_time_t max_warm_up = (sim_time_t)(3 * trx_config.pair_spread_ms + 60000) * 1000;
+    sim_time_t next_check = 0;
+    uint32_t trxs_acked = 0;
+    while ((trxs_acked < num_trxs || counter.tx_ids_paired.size() < num_txs) &&
+            ether.now() < max_warm_up) {
+        manager.run();
+        ether.advance(LOOP_COST_US);
+
+        if (ether.now() >= next_check) {
+            trxs_acked = 0;
+            for (size_t j=0; j<trxs.size(); j++) {
+                trxs_acked += trxs[j]->paired;
+            }
+            next_check = ether.now() + 100000;
+        }
+    }
+
+    const sim_time_t paired_at = ether.now();
+
+    /* Let TX period estimates and the roll call settle */
+    const sim_time_t settle_until = ether.now() + 3 * SAMPLE_PERIOD * 1000;
+    while (ether.now() < settle_until) {
+        manager.run();
+        ether.advance(LOOP_COST_US);
+    }
+
+    /************ Measure ************/
+    const SimStats   stats_before = ether.stats;
+    const OutputCounter counter_before = counter;
+    counter.max_trx_reading_gap = 0;
+    counter.start_periods();
+    const uint32_t   serial_before = Serial.bytes_written;
+    const uint32_t   blocked_before = Serial.blocked_us;
+    const sim_time_t measure_start = ether.now();
+    const sim_time_t measure_end = measure_start + (sim_time_t)periods * SAMPLE_PERIOD * 1000;
+
+    while (ether.now() < measure_end) {
+        manager.run();
+        ether.advance(LOOP_COST_US);
+    }
+
+    const double wall_s = (double)(clock() - wall_start) / CLOCKS_PER_SEC;
+    const double sim_s = ether.now() / 1e6;
+
+    const SimStats s = ether.stats - stats_before;
+    const double trx_per_period = (double)(counter.trx_readings - counter_before.trx_readings) / periods;
+    const double replies_per_period = (double)(counter.trx_replies - counter_before.trx_replies) / periods;
+    const double tx_per_period = (double)(counter.tx_readings - counter_before.tx_readings) / periods;
+
+    /* Fraction of periods with a reading, from all TRXs, from TRXs with
+     * a changing load and from TRXs with a steady load.  Unplugged TRXs
+     * are neither busy nor steady. */
+    uint32_t num_steady = 0, num_busy = 0;
+    double captured = 0, busy_captured = 0, steady_captured = 0;
+    for (size_t j=0; j<trxs.size(); j++) {
+        /* A TRX first heard late in its first period could be heard
+         * early in one more period at the end */
+        const double fraction = (double)std::min(counter.trx_periods_by_id[trxs[j]->id], periods) / periods;
+        captured += fraction;
+        if (trxs[j]->unplugged) continue;
+        if (trxs[j]->steady) {
+            num_steady++;
+            steady_captured += fraction;
+        } else {
+            num_busy++;
+            busy_captured += fraction;
+        }
+    }
+
+    std::cout.setf(std::ios::fixed);
+    std::cout.precision(1);
+    std::cout << "{\"trxs\": " << num_trxs
+              << ", \"txs\": " << num_txs
+              << ", \"periods\": " << periods
+              << ", \"trxs_acked\": " << trxs_acked
+              << ", \"txs_paired\": " << counter.tx_ids_paired.size()
+              << ", \"paired_after_s\": " << paired_at / 1e6
+              << ",\n \"trx_readings_per_period\": " << trx_per_period
+              << ", \"trx_replies_to_poll_per_period\": " << replies_per_period
+              << ", \"trx_capture_pct\": " << (num_trxs ? 100.0 * captured / num_trxs : 0)
+              << ",\n \"busy_trx_capture_pct\": " << (num_busy ? 100.0 * busy_captured / num_busy : 0)
+              << ", \"steady_trx_capture_pct\": " << (num_steady ? 100.0 * steady_captured / num_steady : 0)
+              << ", \"max_trx_reading_gap_s\": " << counter.trx_reading_gap() / 1e6
+              << ", \"aggregates_merged\": " << counter.aggregates_merged - counter_before.aggregates_merged
+              << ",\n \"tx_readings_per_period\": " << tx_per_period
+              << ", \"tx_capture_pct\": " << (s.tx_sent ? 100.0 * (counter.tx_readings - counter_before.tx_readings) / s.tx_sent : 0)
+              << ",\n \"polls_sent\": " << s.polls_sent
+              << ", \"polls_answered\": " << s.polls_answered
+              << ", \"polls_ignored\": " << s.polls_lost
+              << ", \"transmissions\": " << s.transmissions
+              << ", \"collisions\": " << s.collisions
+              << ", \"rx_dropped\": " << s.rx_dropped
+              << ",\n \"serial_bytes_per_period\": " << (double)(Serial.bytes_written - serial_before) / periods
+              << ", \"serial_blocked_ms_per_period\": " << (Serial.blocked_us - blocked_before) / 1000.0 / periods
+              << ",\n \"simulated_s\": " << sim_s
+              << ", \"wall_s\": " << wall_s
+              << ", \"speedup\": " << (wall_s > 0 ? sim_s / wall_s : 0);
+
+    /* Ask Manager for its own counters */
+    Serial.inject("c");
+    const sim_time_t give_up = ether.now() + 1000000;
+    while (counter.manager_stats.empty() && ether.now() < give_up) {
+        manager.run();
+        ether.advance(LOOP_COST_US);
+    }
+    std::cout << ",\n \"manager_stats\": "
+              << (counter.manager_stats.empty() ? "null" : counter.manager_stats)
+              << "}" << std::endl;
+
+    for (size_t j=0; j<trxs.size(); j++) delete trxs[j];
+    for (size_t j=0; j<txs.size(); j++) delete txs[j];
+
+    return 0;
+}
@@ -0,0 +1,16 @@
+/*
+ * util/atomic.h
+ *
+ *  Simulated interrupts only ever run between two calls into the virtual
+ *  clock, never in the middle of a statement, so atomic blocks are no-ops.
+ */
+
+#ifndef SIM_UTIL_ATOMIC_H_
+#define SIM_UTIL_ATOMIC_H_
+
+#define ATOMIC_BLOCK(type) for (int _sim_atomic = 1; _sim_atomic; _sim_atomic = 0)
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+#define NONATOMIC_BLOCK(type) ATOMIC_BLOCK(type)
+
+#endif /* SIM_UTIL_ATOMIC_H_ */